@@ -0,0 +1,161 @@
+#include "AsyncReader.h"
+
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define HTML_CASE_CORRECTOR_HAVE_POSIX_IO 1
+#endif
+
+// async_reader.cpp
+#ifdef HTML_CASE_CORRECTOR_HAVE_POSIX_IO
+
+struct AsyncReader::Request {
+    fs::path path;
+    int fd = -1;
+    std::string buffer;
+    size_t done = 0;
+    iovec iov;
+};
+
+std::unique_ptr<AsyncReader> AsyncReader::create(unsigned depth, ReadCallback onRead, ErrorCallback onError) {
+    depth = depth == 0 ? kDefaultDepth : depth;
+    auto ring = IoUring::create(depth);
+    if (!ring) {
+        return nullptr;
+    }
+    return std::unique_ptr<AsyncReader>(
+        new AsyncReader(std::move(ring), depth, std::move(onRead), std::move(onError)));
+}
+
+AsyncReader::AsyncReader(std::unique_ptr<IoUring> ring, unsigned depth, ReadCallback onRead, ErrorCallback onError)
+    : ring_(std::move(ring)), onRead_(std::move(onRead)), onError_(std::move(onError)) {
+    for (unsigned i = 0; i < depth; ++i) {
+        requests_.push_back(std::make_unique<Request>());
+        freeSlots_.push_back(depth - 1 - i);
+    }
+}
+
+AsyncReader::~AsyncReader() {
+    // The kernel may still be writing into the buffers
+    try {
+        drain();
+    } catch (...) {
+    }
+}
+
+void AsyncReader::read(const fs::path& path) {
+    while (freeSlots_.empty()) {
+        reapOne();
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        onError_(path, std::runtime_error("Cannot open file: " + path.string()));
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        onError_(path, std::runtime_error("Cannot stat file: " + path.string()));
+        return;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        onRead_(path, std::string());
+        return;
+    }
+
+    size_t slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    Request& request = *requests_[slot];
+    request.path = path;
+    request.fd = fd;
+    request.buffer.resize(static_cast<size_t>(st.st_size));
+    request.done = 0;
+    submit(slot);
+}
+
+void AsyncReader::drain() {
+    while (inFlight_ > 0) {
+        reapOne();
+    }
+}
+
+void AsyncReader::submit(size_t slot) {
+    Request& request = *requests_[slot];
+    request.iov.iov_base = &request.buffer[request.done];
+    request.iov.iov_len = request.buffer.size() - request.done;
+
+    // The ring has one entry per slot, so there is always room
+    ring_->prepareReadv(request.fd, &request.iov, request.done, slot);
+    ++inFlight_;
+}
+
+void AsyncReader::reapOne() {
+    uint64_t slot = 0;
+    int result = 0;
+    if (!ring_->waitCompletion(slot, result)) {
+        throw std::runtime_error("io_uring wait failed");
+    }
+    --inFlight_;
+
+    Request& request = *requests_[slot];
+    if (result < 0) {
+        fail(slot, "Cannot read file: " + request.path.string());
+        return;
+    }
+
+    request.done += static_cast<size_t>(result);
+    if (result == 0) {
+        // The file shrank after fstat; keep what is there
+        request.buffer.resize(request.done);
+    }
+    if (request.done < request.buffer.size()) {
+        submit(slot);  // short read: queue the remainder
+        return;
+    }
+    finish(slot);
+}
+
+void AsyncReader::finish(size_t slot) {
+    Request& request = *requests_[slot];
+    ::close(request.fd);
+    request.fd = -1;
+    fs::path path = std::move(request.path);
+    std::string content = std::move(request.buffer);
+    request.buffer = std::string();
+    freeSlots_.push_back(slot);
+
+    onRead_(path, std::move(content));
+}
+
+void AsyncReader::fail(size_t slot, const std::string& message) {
+    Request& request = *requests_[slot];
+    ::close(request.fd);
+    request.fd = -1;
+    fs::path path = std::move(request.path);
+    request.buffer = std::string();
+    freeSlots_.push_back(slot);
+
+    onError_(path, std::runtime_error(message));
+}
+
+#else
+
+// Without POSIX I/O there is no io_uring either; every caller takes the sync path
+struct AsyncReader::Request {
+};
+
+std::unique_ptr<AsyncReader> AsyncReader::create(unsigned, ReadCallback, ErrorCallback) {
+    return nullptr;
+}
+
+AsyncReader::~AsyncReader() = default;
+void AsyncReader::read(const fs::path&) {}
+void AsyncReader::drain() {}
+
+#endif // HTML_CASE_CORRECTOR_HAVE_POSIX_IO
@@ -0,0 +1,57 @@
+// async_reader.h
+#ifndef ASYNC_READER_H
+#define ASYNC_READER_H
+
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IoUring.h"
+
+namespace fs = std::filesystem;
+
+// Keeps up to `depth` whole-file reads in flight on an io_uring and hands
+// each finished buffer to `onRead`, so cold-cache reads overlap each other
+// and whatever the callback does with earlier files. Driven by one thread:
+// read() queues a file and, once the queue is full, reaps completions.
+class AsyncReader {
+public:
+    using ReadCallback = std::function<void(const fs::path&, std::string content)>;
+    using ErrorCallback = std::function<void(const fs::path&, const std::exception&)>;
+
+    // nullptr when io_uring isn't available; callers fall back to sync reads
+    static std::unique_ptr<AsyncReader> create(unsigned depth, ReadCallback onRead, ErrorCallback onError);
+    ~AsyncReader();
+
+    AsyncReader(const AsyncReader&) = delete;
+    AsyncReader& operator=(const AsyncReader&) = delete;
+
+    void read(const fs::path& path);
+
+    // Wait for every outstanding read
+    void drain();
+
+    static constexpr unsigned kDefaultDepth = 64;
+
+private:
+    struct Request;
+
+    AsyncReader(std::unique_ptr<IoUring> ring, unsigned depth, ReadCallback onRead, ErrorCallback onError);
+
+    void submit(size_t slot);
+    void reapOne();
+    void finish(size_t slot);
+    void fail(size_t slot, const std::string& message);
+
+    std::unique_ptr<IoUring> ring_;
+    ReadCallback onRead_;
+    ErrorCallback onError_;
+    std::vector<std::unique_ptr<Request>> requests_;
+    std::vector<size_t> freeSlots_;
+    size_t inFlight_ = 0;
+};
+
+#endif // ASYNC_READER_H
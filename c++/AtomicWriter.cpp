@@ -0,0 +1,260 @@
+#include "AtomicWriter.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HTML_CASE_CORRECTOR_HAVE_POSIX_IO 1
+#endif
+#if defined(__linux__)
+#include <sys/xattr.h>
+#include <vector>
+#endif
+
+namespace {
+
+#ifdef HTML_CASE_CORRECTOR_HAVE_POSIX_IO
+void fsyncPath(const fs::path& path, int flags) {
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+void writeAll(int fd, std::string_view content, const fs::path& path) {
+    const char* p = content.data();
+    size_t remaining = content.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, p, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Cannot write file: " + path.string());
+        }
+        p += written;
+        remaining -= static_cast<size_t>(written);
+    }
+}
+#endif
+
+#if defined(__linux__)
+// Give the replacement the original's extended attributes, POSIX ACLs and
+// security labels included. Best effort: one the filesystem or our
+// privileges won't let us set is left behind.
+void copyXattrs(const fs::path& from, int to) {
+    ssize_t size = ::listxattr(from.c_str(), nullptr, 0);
+    if (size <= 0) {
+        return;
+    }
+    std::vector<char> names(static_cast<size_t>(size));
+    size = ::listxattr(from.c_str(), names.data(), names.size());
+    if (size <= 0) {
+        return;
+    }
+    std::vector<char> value;
+    for (const char* name = names.data(); name < names.data() + size; name += std::strlen(name) + 1) {
+        ssize_t length = ::getxattr(from.c_str(), name, nullptr, 0);
+        if (length < 0) {
+            continue;
+        }
+        value.resize(static_cast<size_t>(length));
+        length = ::getxattr(from.c_str(), name, value.data(), value.size());
+        if (length >= 0) {
+            ::fsetxattr(to, name, value.data(), static_cast<size_t>(length), 0);
+        }
+    }
+}
+#endif
+
+fs::path parentOrCurrent(const fs::path& path) {
+    fs::path parent = path.parent_path();
+    return parent.empty() ? fs::path(".") : parent;
+}
+
+} // namespace
+
+// atomic_writer.cpp
+AtomicWriter::AtomicWriter(SyncPolicy policy, size_t batchSize)
+    : policy_(policy), batchSize_(batchSize == 0 ? 1 : batchSize) {
+}
+
+AtomicWriter::~AtomicWriter() {
+    try {
+        flush();
+    } catch (...) {
+        // Nothing sensible to do with a sync failure during teardown
+    }
+}
+
+void AtomicWriter::write(const fs::path& path, std::string_view content) {
+    std::unique_ptr<Replacement> replacement = begin(path);
+    replacement->append(content);
+    replacement->commit();
+}
+
+std::unique_ptr<AtomicWriter::Replacement> AtomicWriter::begin(const fs::path& path) {
+    return std::unique_ptr<Replacement>(new Replacement(*this, path));
+}
+
+AtomicWriter::Replacement::Replacement(AtomicWriter& writer, const fs::path& path)
+    : writer_(writer), path_(path) {
+    // Replace the file a symlink points to, not the link itself
+    std::error_code ec;
+    target_ = fs::is_symlink(path, ec) ? fs::canonical(path) : path;
+
+#ifdef HTML_CASE_CORRECTOR_HAVE_POSIX_IO
+    std::string temp = (parentOrCurrent(target_) / ("." + target_.filename().string() + ".XXXXXX")).string();
+    fd_ = ::mkstemp(temp.data());
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot write file: " + path.string());
+    }
+    temp_ = temp;
+#else
+    temp_ = target_;
+    temp_ += ".tmp";
+    file_.open(temp_, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        throw std::runtime_error("Cannot write file: " + path.string());
+    }
+#endif
+}
+
+AtomicWriter::Replacement::~Replacement() {
+    if (committed_) {
+        return;
+    }
+    std::error_code ec;
+#ifdef HTML_CASE_CORRECTOR_HAVE_POSIX_IO
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#else
+    file_.close();
+#endif
+    fs::remove(temp_, ec);
+}
+
+void AtomicWriter::Replacement::append(std::string_view content) {
+#ifdef HTML_CASE_CORRECTOR_HAVE_POSIX_IO
+    writeAll(fd_, content, path_);
+#else
+    if (!file_.write(content.data(), static_cast<std::streamsize>(content.size()))) {
+        throw std::runtime_error("Cannot write file: " + path_.string());
+    }
+#endif
+    size_ += content.size();
+}
+
+void AtomicWriter::Replacement::commit() {
+#ifdef HTML_CASE_CORRECTOR_HAVE_POSIX_IO
+    struct stat original;
+    if (::stat(target_.c_str(), &original) == 0) {
+        // mkstemp creates 0600; keep the page's own mode and, if allowed, owner
+        ::fchmod(fd_, original.st_mode & 07777);
+        if (::fchown(fd_, original.st_uid, original.st_gid) != 0) {
+            // Not permitted for other users' files; the mode is what matters
+        }
+#if defined(__linux__)
+        // After the mode: setting an access ACL sets the mode bits as well
+        copyXattrs(target_, fd_);
+#endif
+    }
+    if (writer_.policy_ == SyncPolicy::File && ::fsync(fd_) != 0) {
+        throw std::runtime_error("Cannot sync file: " + path_.string());
+    }
+
+    const int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) != 0 || ::rename(temp_.c_str(), target_.c_str()) != 0) {
+        throw std::runtime_error("Cannot write file: " + path_.string());
+    }
+    committed_ = true;
+
+    if (writer_.policy_ == SyncPolicy::File) {
+        // Persist the rename itself
+        fsyncPath(parentOrCurrent(target_), O_RDONLY | O_DIRECTORY);
+    }
+#else
+    if (!file_.flush()) {
+        throw std::runtime_error("Cannot write file: " + path_.string());
+    }
+    file_.close();
+    std::error_code ec;
+    fs::rename(temp_, target_, ec);
+    if (ec) {
+        throw std::runtime_error("Cannot write file: " + path_.string());
+    }
+    committed_ = true;
+#endif
+
+    writer_.replaced(target_);
+}
+
+void AtomicWriter::replaced(const fs::path& target) {
+    if (policy_ != SyncPolicy::Batch) {
+        return;
+    }
+    std::vector<fs::path> group;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unsynced_.push_back(target);
+        if (unsynced_.size() < batchSize_) {
+            return;
+        }
+        group.swap(unsynced_);
+    }
+    syncGroup(std::move(group));
+}
+
+void AtomicWriter::flush() {
+    std::vector<fs::path> group;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        group.swap(unsynced_);
+    }
+    syncGroup(std::move(group));
+}
+
+void AtomicWriter::syncGroup(std::vector<fs::path> group) {
+    if (group.empty()) {
+        return;
+    }
+
+#if defined(__linux__)
+    // One syncfs per filesystem flushes the data and renames of the whole
+    // group; in practice every file of a run lives on one or a few.
+    std::vector<dev_t> synced;
+    for (const auto& file : group) {
+        struct stat st;
+        if (::stat(file.c_str(), &st) != 0) {
+            continue;
+        }
+        bool seen = false;
+        for (dev_t device : synced) {
+            seen = seen || device == st.st_dev;
+        }
+        if (seen) {
+            continue;
+        }
+        int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::syncfs(fd);
+            ::close(fd);
+        }
+        synced.push_back(st.st_dev);
+    }
+#elif defined(HTML_CASE_CORRECTOR_HAVE_POSIX_IO)
+    for (const auto& file : group) {
+        fsyncPath(file, O_RDONLY);
+        fsyncPath(parentOrCurrent(file), O_RDONLY | O_DIRECTORY);
+    }
+#endif
+}
@@ -0,0 +1,101 @@
+// atomic_writer.h
+#ifndef ATOMIC_WRITER_H
+#define ATOMIC_WRITER_H
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// How hard writes are pushed to stable storage
+enum class SyncPolicy {
+    None,   // atomic replace only; the kernel flushes when it likes
+    Batch,  // one filesystem-wide sync per group of files
+    File    // fsync every file and its directory before returning
+};
+
+// Replaces files atomically: the new content goes to a temporary file next
+// to the target, which is then renamed over it, so readers and crashes see
+// either the old page or the new one, never a truncated mix.
+//
+// The replacement keeps the original's mode, its owner where permitted, and
+// on Linux its extended attributes (so its ACLs and SELinux label too). It
+// is a new file, though: a page with other hard links is split from them,
+// which keep the old content.
+//
+// With SyncPolicy::Batch the fsyncs are coalesced: after every `batchSize`
+// files (and on flush()) a single syncfs covers the whole group. In that mode
+// a power loss can still lose the most recent, unsynced group; on
+// filesystems that don't persist data before a rename over an existing file,
+// use SyncPolicy::File.
+class AtomicWriter {
+public:
+    explicit AtomicWriter(SyncPolicy policy = SyncPolicy::None, size_t batchSize = kDefaultBatchSize);
+    ~AtomicWriter();
+
+    AtomicWriter(const AtomicWriter&) = delete;
+    AtomicWriter& operator=(const AtomicWriter&) = delete;
+
+    // Replacement of one file whose new content arrives in pieces. Nothing
+    // happens to the file until commit(); one destroyed without a commit
+    // removes its temporary file. Throws std::runtime_error.
+    class Replacement {
+    public:
+        ~Replacement();
+
+        Replacement(const Replacement&) = delete;
+        Replacement& operator=(const Replacement&) = delete;
+
+        void append(std::string_view content);
+
+        // Put the new content in place, as write() would
+        void commit();
+
+        size_t size() const { return size_; }
+
+    private:
+        friend class AtomicWriter;
+        Replacement(AtomicWriter& writer, const fs::path& path);
+
+        AtomicWriter& writer_;
+        fs::path path_;    // as given, for messages
+        fs::path target_;  // what a symlink points to
+        fs::path temp_;
+        size_t size_ = 0;
+        bool committed_ = false;
+#if defined(__unix__) || defined(__APPLE__)
+        int fd_ = -1;
+#else
+        std::ofstream file_;
+#endif
+    };
+
+    // Throws std::runtime_error; `path` is left untouched on failure
+    void write(const fs::path& path, std::string_view content);
+
+    // Start replacing `path` (throws std::runtime_error)
+    std::unique_ptr<Replacement> begin(const fs::path& path);
+
+    // Sync whatever the current group holds
+    void flush();
+
+    static constexpr size_t kDefaultBatchSize = 256;
+
+private:
+    // Count a replaced file towards the current group
+    void replaced(const fs::path& target);
+
+    void syncGroup(std::vector<fs::path> group);
+
+    SyncPolicy policy_;
+    size_t batchSize_;
+    std::mutex mutex_;
+    std::vector<fs::path> unsynced_;  // files written since the last group sync
+};
+
+#endif // ATOMIC_WRITER_H
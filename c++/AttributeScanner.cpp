@@ -0,0 +1,269 @@
+#include "AttributeScanner.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Elements whose content is text up to the matching end tag
+bool isRawTextElement(std::string_view tag) {
+    static constexpr std::string_view kRawText[] = {
+        "script", "style", "textarea", "title", "xmp", "iframe", "noembed", "noframes"
+    };
+    for (std::string_view name : kRawText) {
+        if (equalsIgnoreCase(tag, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Offset of the `</tag` that closes a raw-text element, or npos. Unless
+// `html` ends the document, a name that runs into its end isn't known to
+// end there.
+size_t findEndTag(std::string_view html, size_t pos, std::string_view tag, bool atEnd = true) {
+    while ((pos = html.find("</", pos)) != std::string_view::npos) {
+        size_t nameEnd = pos + 2 + tag.size();
+        if (nameEnd <= html.size() && equalsIgnoreCase(html.substr(pos + 2, tag.size()), tag) &&
+            (nameEnd == html.size() ? atEnd
+                                    : isSpace(html[nameEnd]) || html[nameEnd] == '/' || html[nameEnd] == '>')) {
+            return pos;
+        }
+        pos += 2;
+    }
+    return std::string_view::npos;
+}
+
+struct ScanResult {
+    bool reliable;
+    size_t consumed;
+};
+
+// Shared by both entry points. On a window (`streaming`), a token cut off
+// by the end of `html` stops the scan at its start unless `final`, values
+// that would need decoding are skipped instead of failing, and raw text or
+// comments that run past the end are consumed up to a tail that might hold
+// the start of their terminator, leaving `state` inside them.
+ScanResult scan(std::string_view html, bool streaming, bool final, ScanState& state,
+                const std::function<void(const AttributeSpan&)>& onAttribute) {
+    const size_t size = html.size();
+    size_t pos = 0;
+    size_t tokenStart = 0;
+    auto incomplete = [&]() {
+        if (!streaming) {
+            return ScanResult{false, 0};
+        }
+        return ScanResult{true, final ? size : tokenStart};
+    };
+
+    // Attributes are held back until their tag closes, so a tag cut off by
+    // a window is reported once, by the window that completes it
+    static_assert(reference_rules_detail::kRuleCount <= 32, "seen mask holds one bit per rule");
+    std::array<AttributeSpan, reference_rules_detail::kRuleCount> pending;
+    size_t pendingCount = 0;
+
+    if (state.inComment) {
+        size_t end = html.find("-->");
+        if (end == std::string_view::npos) {
+            return ScanResult{true, final ? size : size < 2 ? 0 : size - 2};
+        }
+        state.inComment = false;
+        pos = end + 3;
+    } else if (!state.rawText.empty()) {
+        size_t end = findEndTag(html, 0, state.rawText, final);
+        if (end == std::string_view::npos) {
+            const size_t tail = state.rawText.size() + 2;  // "</" + name + terminator
+            return ScanResult{true, final ? size : size < tail ? 0 : size - tail};
+        }
+        state.rawText.clear();
+        pos = end;
+    }
+
+    while ((pos = html.find('<', pos)) != std::string_view::npos) {
+        tokenStart = pos;
+        if (streaming && !final && size - pos < 4) {
+            return ScanResult{true, pos};  // too little left to tell what starts here
+        }
+
+        if (html.compare(pos, 4, "<!--") == 0) {
+            size_t end = html.find("-->", pos + 4);
+            if (end == std::string_view::npos) {
+                if (!streaming) {
+                    return ScanResult{false, 0};
+                }
+                // Past the opener, and short of a "--" that may begin the closer
+                state.inComment = !final;
+                return ScanResult{true, final ? size : std::max(pos + 4, size - 2)};
+            }
+            pos = end + 3;
+            continue;
+        }
+
+        if (pos + 1 < size && (html[pos + 1] == '!' || html[pos + 1] == '?' || html[pos + 1] == '/')) {
+            // Doctype, processing instruction or end tag: nothing to report
+            size_t end = html.find('>', pos + 1);
+            if (end == std::string_view::npos) {
+                return incomplete();
+            }
+            pos = end + 1;
+            continue;
+        }
+
+        if (pos + 1 >= size || !isAlpha(html[pos + 1])) {
+            ++pos;
+            continue;
+        }
+
+        // Start tag name
+        size_t nameStart = pos + 1;
+        pos = nameStart;
+        while (pos < size && !isSpace(html[pos]) && html[pos] != '/' && html[pos] != '>') {
+            ++pos;
+        }
+        std::string_view tag = html.substr(nameStart, pos - nameStart);
+        const GumboTag tagId = gumbo_tagn_enum(tag.data(), static_cast<unsigned int>(tag.size()));
+
+        // Attributes; like an HTML parser only the first of each name counts.
+        // Rule groups are identified by their first index, one bit each.
+        uint32_t seen = 0;
+        pendingCount = 0;
+        for (;;) {
+            while (pos < size && (isSpace(html[pos]) || html[pos] == '/')) {
+                ++pos;
+            }
+            if (pos >= size) {
+                return incomplete();
+            }
+            if (html[pos] == '>') {
+                ++pos;
+                break;
+            }
+
+            size_t attrStart = pos;
+            while (pos < size && !isSpace(html[pos]) && html[pos] != '/' && html[pos] != '>' &&
+                   (html[pos] != '=' || pos == attrStart)) {
+                ++pos;
+            }
+            std::string_view name = html.substr(attrStart, pos - attrStart);
+
+            while (pos < size && isSpace(html[pos])) {
+                ++pos;
+            }
+            if (pos >= size || html[pos] != '=') {
+                continue;
+            }
+            ++pos;
+            while (pos < size && isSpace(html[pos])) {
+                ++pos;
+            }
+            if (pos >= size) {
+                return incomplete();
+            }
+
+            size_t valueStart;
+            size_t valueEnd;
+            if (html[pos] == '"' || html[pos] == '\'') {
+                valueStart = pos + 1;
+                valueEnd = html.find(html[pos], valueStart);
+                if (valueEnd == std::string_view::npos) {
+                    return incomplete();
+                }
+                pos = valueEnd + 1;
+            } else {
+                valueStart = pos;
+                while (pos < size && !isSpace(html[pos]) && html[pos] != '>') {
+                    ++pos;
+                }
+                valueEnd = pos;
+            }
+
+            const int attribute = referenceAttribute(name);
+            if (attribute < 0 || (seen & (1u << attribute)) != 0) {
+                continue;
+            }
+            seen |= 1u << attribute;
+            const ReferenceKind kind = referenceKind(tagId, attribute);
+            if (kind == ReferenceKind::None) {
+                continue;
+            }
+
+            std::string_view value = html.substr(valueStart, valueEnd - valueStart);
+            if (value.find_first_of(std::string_view("&\r\0", 3)) != std::string_view::npos) {
+                // The parser would decode or normalize this value
+                if (!streaming) {
+                    return ScanResult{false, 0};
+                }
+                continue;
+            }
+            pending[pendingCount++] = AttributeSpan{tag, name, valueStart, valueEnd - valueStart, kind};
+        }
+
+        if (isRawTextElement(tag)) {
+            size_t end = findEndTag(html, pos, tag, !streaming || final);
+            if (end == std::string_view::npos && streaming && !final) {
+                if (tagId == GUMBO_TAG_STYLE) {
+                    return ScanResult{true, tokenStart};  // the sheet is scanned whole
+                }
+                for (size_t i = 0; i < pendingCount; ++i) {
+                    onAttribute(pending[i]);
+                }
+                state.rawText = std::string(tag);
+                const size_t tail = tag.size() + 2;
+                return ScanResult{true, std::max(pos, size < tail ? 0 : size - tail)};
+            }
+            for (size_t i = 0; i < pendingCount; ++i) {
+                onAttribute(pending[i]);
+            }
+            if (tagId == GUMBO_TAG_STYLE) {
+                // Raw text is never decoded, so the style sheet splices as is
+                size_t sheetEnd = end == std::string_view::npos ? size : end;
+                onAttribute(AttributeSpan{tag, std::string_view(), pos, sheetEnd - pos, ReferenceKind::Css});
+            }
+            if (end == std::string_view::npos) {
+                break;
+            }
+            pos = end;
+            continue;
+        }
+        for (size_t i = 0; i < pendingCount; ++i) {
+            onAttribute(pending[i]);
+        }
+    }
+
+    return ScanResult{true, size};
+}
+
+} // namespace
+
+// attribute_scanner.cpp
+bool scanAttributes(std::string_view html, const std::function<void(const AttributeSpan&)>& onAttribute) {
+    ScanState state;
+    return scan(html, false, true, state, onAttribute).reliable;
+}
+
+size_t scanAttributeWindow(std::string_view html, bool final, ScanState& state,
+                           const std::function<void(const AttributeSpan&)>& onAttribute) {
+    return scan(html, true, final, state, onAttribute).consumed;
+}
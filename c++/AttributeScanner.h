@@ -0,0 +1,51 @@
+// attribute_scanner.h
+#ifndef ATTRIBUTE_SCANNER_H
+#define ATTRIBUTE_SCANNER_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "ReferenceRules.h"
+
+// One reference attribute found inside a start tag. The value span excludes
+// quotes. The text of a <style> element is reported too, with an empty name.
+struct AttributeSpan {
+    std::string_view tag;
+    std::string_view name;
+    size_t valueOffset;
+    size_t valueLength;
+    ReferenceKind kind;
+};
+
+// Streaming tag/attribute tokenizer: walks the markup once, skipping text,
+// comments and raw-text elements such as <script>, and reports the
+// attributes of every start tag that kReferenceRules lists, plus the content
+// of <style> elements, without building a DOM.
+//
+// Returns false when the document can't be scanned reliably (unterminated
+// comments, tags or quotes, or values containing character references); the
+// caller should then fall back to a full parser for that document.
+bool scanAttributes(std::string_view html, const std::function<void(const AttributeSpan&)>& onAttribute);
+
+// Where a windowed scan left off between windows
+struct ScanState {
+    std::string rawText;     // inside this raw-text element (never <style>)
+    bool inComment = false;
+};
+
+// Scan one window of a document too large to hold at once; `final` marks
+// the window that reaches the end of the document. Returns how many bytes
+// of `html` were dealt with: the next window must start with the rest.
+// Only tokens that end inside that prefix are reported, so a tag or style
+// sheet cut off by the window comes back whole with the next one. A return
+// of 0 before the final window means a single token fills the whole
+// window, which must then grow.
+//
+// There is no parser to fall back to, so nothing fails: values the parser
+// would decode are skipped, and an unterminated tag in the final window is
+// ignored.
+size_t scanAttributeWindow(std::string_view html, bool final, ScanState& state,
+                           const std::function<void(const AttributeSpan&)>& onAttribute);
+
+#endif // ATTRIBUTE_SCANNER_H
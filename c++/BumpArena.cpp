@@ -0,0 +1,61 @@
+#include "BumpArena.h"
+
+#include <algorithm>
+
+// bump_arena.cpp
+BumpArena::BumpArena(size_t chunkSize)
+    : chunkSize_(std::max(chunkSize, kAlignment)) {
+}
+
+void* BumpArena::allocate(size_t size) {
+    size = (std::max<size_t>(size, 1) + kAlignment - 1) & ~(kAlignment - 1);
+
+    while (chunks_.empty() || offset_ + size > chunks_[current_].size) {
+        if (!chunks_.empty() && current_ + 1 < chunks_.size()) {
+            ++current_;
+            offset_ = 0;
+            continue;
+        }
+        addChunk(size);
+    }
+
+    void* result = chunks_[current_].data.get() + offset_;
+    offset_ += size;
+    used_ += size;
+    return result;
+}
+
+void BumpArena::reset() {
+    // A document that needed several chunks will likely be followed by a
+    // similar one, so give the next parse a single chunk of that size.
+    if (chunks_.size() > 1) {
+        size_t total = 0;
+        for (const auto& chunk : chunks_) {
+            total += chunk.size;
+        }
+        chunks_.clear();
+        addChunk(std::min(total, kMaxRetained));
+    } else if (!chunks_.empty() && chunks_[0].size > kMaxRetained) {
+        chunks_.clear();
+    }
+
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+void* BumpArena::gumboAllocate(void* userdata, size_t size) {
+    return static_cast<BumpArena*>(userdata)->allocate(size);
+}
+
+void BumpArena::gumboDeallocate(void*, void*) {
+    // Freed in bulk by reset()
+}
+
+void BumpArena::addChunk(size_t minSize) {
+    size_t size = chunks_.empty() ? chunkSize_ : std::min(chunks_.back().size * 2, kMaxRetained);
+    size = std::max(size, minSize);
+    chunks_.push_back(Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    current_ = chunks_.size() - 1;
+    offset_ = 0;
+}
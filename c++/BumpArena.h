@@ -0,0 +1,52 @@
+// bump_arena.h
+#ifndef BUMP_ARENA_H
+#define BUMP_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump-pointer allocator for short-lived parse trees. Individual frees are
+// no-ops; everything is released at once by reset(), which keeps the memory
+// around (coalesced into one chunk) for the next document.
+class BumpArena {
+public:
+    explicit BumpArena(size_t chunkSize = kDefaultChunkSize);
+
+    BumpArena(const BumpArena&) = delete;
+    BumpArena& operator=(const BumpArena&) = delete;
+
+    // 16-byte aligned storage valid until the next reset()
+    void* allocate(size_t size);
+
+    // Drop every allocation, retaining up to kMaxRetained bytes for reuse
+    void reset();
+
+    // Bytes handed out since the last reset
+    size_t bytesUsed() const { return used_; }
+
+    // Adapters for GumboOptions::allocator / deallocator; userdata is the arena
+    static void* gumboAllocate(void* userdata, size_t size);
+    static void gumboDeallocate(void* userdata, void* ptr);
+
+    static constexpr size_t kDefaultChunkSize = 64 * 1024;
+    static constexpr size_t kMaxRetained = 16 * 1024 * 1024;
+
+private:
+    static constexpr size_t kAlignment = 16;
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void addChunk(size_t minSize);
+
+    size_t chunkSize_;
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0;  // chunk being carved
+    size_t offset_ = 0;   // next free byte in chunks_[current_]
+    size_t used_ = 0;
+};
+
+#endif // BUMP_ARENA_H
@@ -0,0 +1,285 @@
+#include "CaseFolding.h"
+
+#include <array>
+
+namespace {
+constexpr std::array<unsigned char, 128> makeAsciiFold() {
+    std::array<unsigned char, 128> table{};
+    for (unsigned c = 0; c < table.size(); ++c) {
+        table[c] = static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+    }
+    return table;
+}
+
+constexpr std::array<unsigned char, 128> kAsciiFold = makeAsciiFold();
+
+// Bytes that aren't part of a valid sequence decode to kRawByte + byte,
+// which lies outside the Unicode range and is written back out unchanged
+constexpr char32_t kRawByte = 0x110000;
+
+bool isContinuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+// Decode the sequence starting at text[i] (a non-ASCII lead byte) and
+// advance past it
+char32_t decode(std::string_view text, size_t& i) {
+    const auto byte = [&text](size_t at) { return static_cast<unsigned char>(text[at]); };
+    const unsigned char lead = byte(i);
+    const size_t left = text.size() - i;
+
+    if (lead >= 0xC2 && lead <= 0xDF && left >= 2 && isContinuation(byte(i + 1))) {
+        char32_t c = (char32_t(lead & 0x1F) << 6) | (byte(i + 1) & 0x3F);
+        i += 2;
+        return c;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF && left >= 3 && isContinuation(byte(i + 1)) && isContinuation(byte(i + 2))) {
+        char32_t c = (char32_t(lead & 0x0F) << 12) | (char32_t(byte(i + 1) & 0x3F) << 6) | (byte(i + 2) & 0x3F);
+        // Reject overlong forms and surrogates
+        if (c >= 0x800 && (c < 0xD800 || c > 0xDFFF)) {
+            i += 3;
+            return c;
+        }
+    }
+    if (lead >= 0xF0 && lead <= 0xF4 && left >= 4 && isContinuation(byte(i + 1)) &&
+        isContinuation(byte(i + 2)) && isContinuation(byte(i + 3))) {
+        char32_t c = (char32_t(lead & 0x07) << 18) | (char32_t(byte(i + 1) & 0x3F) << 12) |
+                     (char32_t(byte(i + 2) & 0x3F) << 6) | (byte(i + 3) & 0x3F);
+        if (c >= 0x10000 && c <= 0x10FFFF) {
+            i += 4;
+            return c;
+        }
+    }
+    ++i;
+    return kRawByte + lead;
+}
+
+// Fold pairs laid out as (upper, lower) alternating from an even code point
+char32_t foldEvenPair(char32_t c) {
+    return (c & 1) ? c : c + 1;
+}
+
+// Same, for pairs that start on an odd code point
+char32_t foldOddPair(char32_t c) {
+    return (c & 1) ? c + 1 : c;
+}
+
+char32_t foldLatin(char32_t c) {
+    if (c < 0x100) {
+        if (c >= 0xC0 && c <= 0xDE && c != 0xD7) {
+            return c + 0x20;
+        }
+        return c == 0xB5 ? 0x3BC : c;
+    }
+    if (c < 0x180) {
+        switch (c) {
+        case 0x130: case 0x131: case 0x138: case 0x149:
+            return c;  // dotted I and the unpaired letters have no simple fold
+        case 0x178:
+            return 0xFF;
+        case 0x17F:
+            return 's';
+        }
+        if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) {
+            return foldOddPair(c);
+        }
+        return foldEvenPair(c);
+    }
+    switch (c) {
+    case 0x1C4: case 0x1C5: return 0x1C6;
+    case 0x1C7: case 0x1C8: return 0x1C9;
+    case 0x1CA: case 0x1CB: return 0x1CC;
+    case 0x1F1: case 0x1F2: return 0x1F3;
+    case 0x1F4: return 0x1F5;
+    }
+    if (c >= 0x1CD && c <= 0x1DC) {
+        return foldOddPair(c);
+    }
+    if ((c >= 0x1DE && c <= 0x1EF) || (c >= 0x1F8 && c <= 0x21F) ||
+        (c >= 0x222 && c <= 0x233) || (c >= 0x246 && c <= 0x24F)) {
+        return foldEvenPair(c);
+    }
+    return c;
+}
+
+char32_t foldGreek(char32_t c) {
+    if ((c >= 0x391 && c <= 0x3A1) || (c >= 0x3A3 && c <= 0x3AB)) {
+        return c + 0x20;
+    }
+    switch (c) {
+    case 0x370: case 0x372: case 0x376: return c + 1;
+    case 0x37F: return 0x3F3;
+    case 0x386: return 0x3AC;
+    case 0x388: case 0x389: case 0x38A: return c + 0x25;
+    case 0x38C: return 0x3CC;
+    case 0x38E: case 0x38F: return c + 0x3F;
+    case 0x3C2: return 0x3C3;
+    case 0x3CF: return 0x3D7;
+    case 0x3D0: return 0x3B2;
+    case 0x3D1: return 0x3B8;
+    case 0x3D5: return 0x3C6;
+    case 0x3D6: return 0x3C0;
+    case 0x3F0: return 0x3BA;
+    case 0x3F1: return 0x3C1;
+    case 0x3F4: return 0x3B8;
+    case 0x3F5: return 0x3B5;
+    case 0x3F7: return 0x3F8;
+    case 0x3F9: return 0x3F2;
+    case 0x3FA: return 0x3FB;
+    case 0x3FD: case 0x3FE: case 0x3FF: return c - 0x82;
+    }
+    if (c >= 0x3D8 && c <= 0x3EF) {
+        return foldEvenPair(c);
+    }
+    return c;
+}
+
+char32_t foldCyrillic(char32_t c) {
+    if (c < 0x410) {
+        return c + 0x50;
+    }
+    if (c < 0x430) {
+        return c + 0x20;
+    }
+    if (c == 0x4C0) {
+        return 0x4CF;
+    }
+    if (c >= 0x4C1 && c <= 0x4CE) {
+        return foldOddPair(c);
+    }
+    if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF) || (c >= 0x4D0 && c <= 0x52F)) {
+        return foldEvenPair(c);
+    }
+    return c;
+}
+
+char32_t foldCodePoint(char32_t c) {
+    if (c < 0x80) {
+        return kAsciiFold[c];
+    }
+    if (c < 0x250) {
+        return foldLatin(c);
+    }
+    if (c >= 0x370 && c < 0x400) {
+        return foldGreek(c);
+    }
+    if (c >= 0x400 && c < 0x530) {
+        return foldCyrillic(c);
+    }
+    if (c >= 0x531 && c <= 0x556) {
+        return c + 0x30;  // Armenian
+    }
+    if ((c >= 0x10A0 && c <= 0x10C5) || c == 0x10C7 || c == 0x10CD) {
+        return c + 0x1C60;  // Georgian
+    }
+    if (c >= 0x1E00 && c < 0x1F00) {
+        if (c == 0x1E9B) {
+            return 0x1E61;
+        }
+        if (c == 0x1E9E) {
+            return 0xDF;
+        }
+        return (c <= 0x1E95 || c >= 0x1EA0) ? foldEvenPair(c) : c;
+    }
+    switch (c) {
+    case 0x2126: return 0x3C9;  // ohm sign
+    case 0x212A: return 'k';    // kelvin sign
+    case 0x212B: return 0xE5;   // angstrom sign
+    case 0x2132: return 0x214E;
+    case 0x2183: return 0x2184;
+    }
+    if (c >= 0x2160 && c <= 0x216F) {
+        return c + 0x10;  // roman numerals
+    }
+    if (c >= 0x24B6 && c <= 0x24CF) {
+        return c + 0x1A;  // circled letters
+    }
+    if (c >= 0x2C00 && c <= 0x2C2F) {
+        return c + 0x30;  // Glagolitic
+    }
+    if (c >= 0xFF21 && c <= 0xFF3A) {
+        return c + 0x20;  // fullwidth Latin
+    }
+    if (c >= 0x10400 && c <= 0x10427) {
+        return c + 0x28;  // Deseret
+    }
+    return c;
+}
+
+// Folded code point starting at text[i]; advances i past it
+char32_t nextFolded(std::string_view text, size_t& i) {
+    const auto byte = static_cast<unsigned char>(text[i]);
+    if (byte < 0x80) {
+        ++i;
+        return kAsciiFold[byte];
+    }
+    char32_t c = decode(text, i);
+    return c >= kRawByte ? c : foldCodePoint(c);
+}
+
+size_t encodedSize(char32_t c) {
+    if (c < 0x80 || c >= kRawByte) {
+        return 1;
+    }
+    return c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+void encode(char32_t c, std::string& out) {
+    if (c >= kRawByte) {
+        out.push_back(static_cast<char>(c - kRawByte));
+    } else if (c < 0x80) {
+        out.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+}
+
+// case_folding.cpp
+void appendFolded(std::string_view text, std::string& out) {
+    out.reserve(out.size() + text.size());
+    for (size_t i = 0; i < text.size();) {
+        const auto byte = static_cast<unsigned char>(text[i]);
+        if (byte < 0x80) {
+            out.push_back(static_cast<char>(kAsciiFold[byte]));
+            ++i;
+        } else {
+            encode(nextFolded(text, i), out);
+        }
+    }
+}
+
+std::string foldCase(std::string_view text) {
+    std::string folded;
+    appendFolded(text, folded);
+    return folded;
+}
+
+size_t foldedSize(std::string_view text) {
+    size_t size = 0;
+    for (size_t i = 0; i < text.size();) {
+        size += encodedSize(nextFolded(text, i));
+    }
+    return size;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (nextFolded(a, i) != nextFolded(b, j)) {
+            return false;
+        }
+    }
+    return i == a.size() && j == b.size();
+}
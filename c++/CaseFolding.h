@@ -0,0 +1,29 @@
+// case_folding.h
+#ifndef CASE_FOLDING_H
+#define CASE_FOLDING_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Locale-independent case folding for UTF-8 filenames. ASCII bytes go through
+// a lookup table; other code points use Unicode simple case folding for the
+// Latin, Greek, Cyrillic and Armenian blocks plus the fullwidth and
+// letterlike forms. Bytes that aren't valid UTF-8 are left as they are, so
+// any byte string folds to something deterministic.
+//
+// Folding works one code point at a time, so foldCase(a + b) is always
+// foldCase(a) + foldCase(b).
+
+// Append the folded form of `text` to `out`
+void appendFolded(std::string_view text, std::string& out);
+
+std::string foldCase(std::string_view text);
+
+// Byte length of foldCase(text), computed without allocating
+size_t foldedSize(std::string_view text);
+
+// foldCase(a) == foldCase(b), computed without allocating
+bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+#endif // CASE_FOLDING_H
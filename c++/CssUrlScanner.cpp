@@ -0,0 +1,142 @@
+#include "CssUrlScanner.h"
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool isNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '-' || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool matchesAt(std::string_view css, size_t pos, std::string_view lowercase) {
+    if (css.size() - pos < lowercase.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lowercase.size(); ++i) {
+        if (lower(css[pos + i]) != lowercase[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t skipSpace(std::string_view css, size_t pos) {
+    while (pos < css.size() && isSpace(css[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+// End of the string opening at `pos` (just past its closing quote). An
+// escaped quote doesn't close it; an unescaped newline ends it unclosed.
+size_t skipString(std::string_view css, size_t pos, bool& escaped) {
+    const char quote = css[pos++];
+    escaped = false;
+    while (pos < css.size()) {
+        char c = css[pos];
+        if (c == quote) {
+            return pos + 1;
+        }
+        if (c == '\n') {
+            return pos;
+        }
+        if (c == '\\') {
+            escaped = true;
+            ++pos;
+        }
+        ++pos;
+    }
+    return css.size();
+}
+
+void reportString(std::string_view css, size_t start, size_t end,
+                  const std::function<void(size_t, size_t)>& onUrl) {
+    // [start, end) spans the quotes; only a properly closed string counts
+    if (end - start > 2 && css[end - 1] == css[start]) {
+        onUrl(start + 1, end - start - 2);
+    }
+}
+
+// Scan the argument of a url( whose '(' ends just before `pos`
+size_t scanUrl(std::string_view css, size_t pos, const std::function<void(size_t, size_t)>& onUrl) {
+    pos = skipSpace(css, pos);
+    if (pos >= css.size()) {
+        return pos;
+    }
+
+    if (css[pos] == '"' || css[pos] == '\'') {
+        bool escaped;
+        size_t end = skipString(css, pos, escaped);
+        if (!escaped) {
+            reportString(css, pos, end, onUrl);
+        }
+        return end;
+    }
+
+    // Unquoted: runs to ')' with nothing but whitespace before it
+    const size_t start = pos;
+    bool valid = true;
+    while (pos < css.size() && css[pos] != ')' && !isSpace(css[pos])) {
+        char c = css[pos];
+        if (c == '\\' || c == '"' || c == '\'' || c == '(') {
+            valid = false;
+        }
+        ++pos;
+    }
+    const size_t end = pos;
+    pos = skipSpace(css, pos);
+    if (pos >= css.size() || css[pos] != ')') {
+        return pos;
+    }
+    if (valid && end > start) {
+        onUrl(start, end - start);
+    }
+    return pos + 1;
+}
+
+} // namespace
+
+// css_url_scanner.cpp
+void scanCssUrls(std::string_view css, const std::function<void(size_t offset, size_t length)>& onUrl) {
+    size_t pos = 0;
+    while (pos < css.size()) {
+        const char c = css[pos];
+
+        if (c == '/' && pos + 1 < css.size() && css[pos + 1] == '*') {
+            size_t end = css.find("*/", pos + 2);
+            if (end == std::string_view::npos) {
+                return;
+            }
+            pos = end + 2;
+        } else if (c == '"' || c == '\'') {
+            bool escaped;
+            pos = skipString(css, pos, escaped);
+        } else if (c == '\\') {
+            pos += 2;
+        } else if ((c == 'u' || c == 'U') && matchesAt(css, pos, "url(") &&
+                   (pos == 0 || !isNameChar(css[pos - 1]))) {
+            pos = scanUrl(css, pos + 4, onUrl);
+        } else if (c == '@' && matchesAt(css, pos + 1, "import") &&
+                   (pos + 7 >= css.size() || !isNameChar(css[pos + 7]))) {
+            // @import "file.css"; the url(...) form is handled above
+            pos = skipSpace(css, pos + 7);
+            if (pos < css.size() && (css[pos] == '"' || css[pos] == '\'')) {
+                bool escaped;
+                size_t end = skipString(css, pos, escaped);
+                if (!escaped) {
+                    reportString(css, pos, end, onUrl);
+                }
+                pos = end;
+            }
+        } else {
+            ++pos;
+        }
+    }
+}
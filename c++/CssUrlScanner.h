@@ -0,0 +1,16 @@
+// css_url_scanner.h
+#ifndef CSS_URL_SCANNER_H
+#define CSS_URL_SCANNER_H
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+// Single forward pass over a style sheet or a declaration list that reports
+// the span of every url(...) argument and @import string, quotes excluded.
+// Comments and other strings are skipped. URLs written with CSS escapes
+// can't be spliced byte for byte and are not reported. Nothing is allocated,
+// so the spans feed straight into the splice rewriter.
+void scanCssUrls(std::string_view css, const std::function<void(size_t offset, size_t length)>& onUrl);
+
+#endif // CSS_URL_SCANNER_H
@@ -0,0 +1,601 @@
+#include "DirectoryIndex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
+
+#include "CaseFolding.h"
+
+namespace {
+IndexSnapshot::EntryType typeOf(fs::file_type type) {
+    switch (type) {
+    case fs::file_type::regular: return IndexSnapshot::EntryType::File;
+    case fs::file_type::directory: return IndexSnapshot::EntryType::Directory;
+    case fs::file_type::symlink: return IndexSnapshot::EntryType::Symlink;
+    default: return IndexSnapshot::EntryType::Other;
+    }
+}
+
+// How a directory is named in a snapshot, whatever the working directory
+std::string snapshotKey(const fs::path& directory) {
+    std::error_code ec;
+    std::string key = fs::absolute(directory, ec).lexically_normal().string();
+    if (key.size() > 1 && key.back() == '/') {
+        key.pop_back();
+    }
+    return key;
+}
+
+// Coarse timestamps (NFS, FAT) tick every second or two
+constexpr std::chrono::seconds kMtimeGranularity{2};
+}
+
+// directory_index.cpp
+DirectoryIndex::DirectoryIndex(Source source)
+    : source_(source) {
+}
+
+DirectoryIndex::~DirectoryIndex() {
+    dropListings();
+}
+
+std::optional<std::string> DirectoryIndex::lookup(const fs::path& directory, std::string_view name) {
+    auto actual = lookup(listingOf(paths_.intern(directory)), name);
+    if (!actual) {
+        return std::nullopt;
+    }
+    return std::string(*actual);
+}
+
+std::optional<std::string_view> DirectoryIndex::lookup(Id directory, std::string_view name) {
+    const Listing& listing = listingFor(directory);
+    // Folded into a per-thread buffer: lookups are the hot path, and one
+    // that only finds a name shouldn't allocate
+    thread_local std::string folded;
+    folded.clear();
+    appendFolded(name, folded);
+    if (listing.snapshot != kNotInSnapshot) {
+        return snapshot_->lookup(listing.snapshot, folded);
+    }
+    if (!listing.entries) {
+        return std::nullopt;
+    }
+
+    // Every name that folds alike is kept, as a case-sensitive filesystem
+    // can hold logo.png next to Logo.png; one spelled as asked is already right
+    auto range = listing.entries->equal_range(folded);
+    if (range.first == range.second) {
+        return std::nullopt;
+    }
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.name == name) {
+            return it->second.name;
+        }
+    }
+    return range.first->second.name;
+}
+
+std::optional<fs::path> DirectoryIndex::resolve(const fs::path& path) {
+    Id actual = resolve(paths_.intern(path));
+    if (actual == PathTable::kNone) {
+        return std::nullopt;
+    }
+    return paths_.toPath(actual);
+}
+
+DirectoryIndex::Id DirectoryIndex::resolve(Id path) {
+    if (const ResolutionSlot* cached = resolved_.find(path)) {
+        Resolution resolution;
+        if (cached->load(resolution)) {
+            return resolution.actual;
+        }
+    }
+
+    Id result = PathTable::kNone;
+    Id listed = PathTable::kNone;
+    const std::string_view name = paths_.name(path);
+
+    if (path == PathTable::kEmpty || (paths_.parent(path) == PathTable::kEmpty && name == "/")) {
+        // Root or empty path: nothing left to correct
+        result = path;
+    } else {
+        Id actualParent = resolve(paths_.parent(path));
+        if (actualParent != PathTable::kNone) {
+            if (name.empty() || name == "." || name == "..") {
+                // Trailing separator or dot component: keep it as written
+                result = paths_.child(actualParent, name);
+            } else {
+                listed = listingOf(actualParent);
+                auto actualName = lookup(listed, name);
+                if (actualName) {
+                    result = paths_.child(actualParent, *actualName);
+                }
+            }
+        }
+    }
+
+    // Threads that resolve the same path at once reach the same outcome, so
+    // whichever store lands last is as good as the first
+    resolved_.at(path).store(Resolution{result, listed});
+    return result;
+}
+
+void DirectoryIndex::trust(Id path) {
+    for (Id current = path; current != PathTable::kEmpty; current = paths_.parent(current)) {
+        ResolutionSlot& slot = resolved_.at(current);
+        Resolution resolution;
+        if (slot.load(resolution) && resolution.actual != PathTable::kNone) {
+            break;  // found already, and so was everything above
+        }
+        slot.store(Resolution{current, PathTable::kNone});
+    }
+}
+
+bool DirectoryIndex::ResolutionSlot::load(Resolution& resolution) const {
+    const uint64_t value = packed.load(std::memory_order_acquire);
+    if (value == 0) {
+        return false;
+    }
+    resolution.actual = static_cast<Id>(value);
+    resolution.listed = static_cast<Id>(value >> 32);
+    return true;
+}
+
+void DirectoryIndex::ResolutionSlot::store(const Resolution& resolution) {
+    packed.store(uint64_t(resolution.actual) | (uint64_t(resolution.listed) << 32), std::memory_order_release);
+}
+
+void DirectoryIndex::dependencies(Id path, std::vector<fs::path>& directories) const {
+    for (Id current = path; current != PathTable::kEmpty; current = paths_.parent(current)) {
+        const ResolutionSlot* cached = resolved_.find(current);
+        Resolution resolution;
+        if (!cached || !cached->load(resolution)) {
+            break;
+        }
+        if (resolution.listed != PathTable::kNone) {
+            directories.push_back(paths_.toPath(resolution.listed));
+        }
+    }
+}
+
+void DirectoryIndex::insert(const fs::path& directory, const std::vector<std::string>& names) {
+    std::vector<IndexSnapshot::Entry> entries;
+    entries.reserve(names.size());
+    for (const auto& name : names) {
+        entries.push_back(IndexSnapshot::Entry{name, EntryType::Other});
+    }
+    insert(directory, entries, kNoMtime);
+}
+
+void DirectoryIndex::insert(const fs::path& directory, const std::vector<IndexSnapshot::Entry>& entries,
+                            int64_t mtime) {
+    const Id id = listingOf(paths_.intern(directory));
+    auto listing = std::make_unique<Listing>();
+    bool complete = true;
+    listing->entries = makeEntries(entries, complete);
+    listing->mtime = complete ? settled(mtime) : kNoMtime;
+    listing->readMtime = mtime;
+    publish(id, std::move(listing));
+}
+
+int64_t DirectoryIndex::mtimeOf(const fs::path& directory) {
+    std::error_code ec;
+    const fs::file_time_type time = fs::last_write_time(directory, ec);
+    return ec ? kNoMtime : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+int64_t DirectoryIndex::settled(int64_t mtime) {
+    if (mtime == kNoMtime) {
+        return kNoMtime;
+    }
+    const int64_t now = static_cast<int64_t>(fs::file_time_type::clock::now().time_since_epoch().count());
+    const int64_t window = static_cast<int64_t>(
+        std::chrono::duration_cast<fs::file_time_type::duration>(kMtimeGranularity).count());
+    return now - mtime < window ? kNoMtime : mtime;
+}
+
+void DirectoryIndex::setRecordMtimes(bool record) {
+    recordMtimes_ = record;
+}
+
+bool DirectoryIndex::loadSnapshot(const fs::path& path) {
+    std::unique_ptr<IndexSnapshot> snapshot;
+    try {
+        snapshot = std::make_unique<IndexSnapshot>(path);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+
+    // Listings may point into the snapshot being replaced
+    dropListings();
+    resolved_.clear();
+    snapshot_ = std::move(snapshot);
+    return true;
+}
+
+uint32_t DirectoryIndex::currentInSnapshot(const fs::path& directory, int64_t& mtime) const {
+    mtime = kNoMtime;
+    if (!snapshot_ && !recordMtimes_) {
+        return kNotInSnapshot;
+    }
+    mtime = mtimeOf(directory);
+    if (!snapshot_ || mtime == kNoMtime) {
+        return kNotInSnapshot;
+    }
+    const uint32_t listing = snapshot_->find(snapshotKey(directory));
+    return listing != kNotInSnapshot && snapshot_->mtime(listing) == mtime ? listing : kNotInSnapshot;
+}
+
+bool DirectoryIndex::reuseSnapshot(const fs::path& directory, int64_t& mtime, const VisitEntry& visit) {
+    const uint32_t current = currentInSnapshot(directory, mtime);
+    if (current == kNotInSnapshot) {
+        return false;
+    }
+    snapshot_->forEach(current, [&visit](std::string_view name, std::string_view, EntryType type) {
+        visit(name, type);
+    });
+
+    auto listing = std::make_unique<Listing>();
+    listing->snapshot = current;
+    listing->mtime = mtime;
+    listing->readMtime = mtime;
+    publish(listingOf(paths_.intern(directory)), std::move(listing));
+    return true;
+}
+
+void DirectoryIndex::saveSnapshot(const fs::path& path) const {
+    std::vector<IndexSnapshot::Listing> listings;
+    std::unordered_set<std::string> seen;
+    directories_.forEach([&](Id id, const DirectorySlot& slot) {
+        const Listing* listing = slot.listing.load(std::memory_order_acquire);
+        if (!listing) {
+            return;
+        }
+        IndexSnapshot::Listing saved;
+        saved.directory = snapshotKey(paths_.toPath(id));
+        seen.insert(saved.directory);
+        if (listing->mtime == kNoMtime) {
+            return;
+        }
+        saved.mtime = listing->mtime;
+        if (listing->snapshot == kNotInSnapshot && !listing->entries) {
+            return;
+        }
+        namesOf(*listing, saved.entries);
+        listings.push_back(std::move(saved));
+    });
+
+    // This run's own writes, and anyone else's, may have changed a directory
+    // since it was read
+    listings.erase(std::remove_if(listings.begin(), listings.end(),
+                                  [](const IndexSnapshot::Listing& listing) {
+                                      return mtimeOf(listing.directory) != listing.mtime;
+                                  }),
+                   listings.end());
+
+    // Listings this run never needed stay as they were; the next load
+    // checks their mtimes like any other
+    for (uint32_t i = 0; snapshot_ && i < snapshot_->size(); ++i) {
+        IndexSnapshot::Listing carried;
+        carried.directory = std::string(snapshot_->directory(i));
+        if (seen.count(carried.directory) != 0) {
+            continue;
+        }
+        carried.mtime = snapshot_->mtime(i);
+        snapshot_->forEach(i, [&carried](std::string_view name, std::string_view, EntryType type) {
+            carried.entries.push_back(IndexSnapshot::Entry{std::string(name), type});
+        });
+        listings.push_back(std::move(carried));
+    }
+
+    IndexSnapshot::save(std::move(listings), path);
+}
+
+std::optional<int64_t> DirectoryIndex::listedMtime(const fs::path& directory) {
+    const DirectorySlot* slot = directories_.find(listingOf(paths_.intern(directory)));
+    const Listing* listing = slot ? slot->listing.load(std::memory_order_acquire) : nullptr;
+    if (!listing) {
+        return std::nullopt;
+    }
+    const int64_t mtime = listing->readMtime == kNoMtime ? kNoMtime : mtimeOf(directory);
+    if (mtime == kNoMtime || mtime == listing->readMtime) {
+        return mtime;
+    }
+
+    // Replacing a page in place moves its directory's mtime but not what
+    // the directory holds; anything else means the listing is out of date
+    std::vector<IndexSnapshot::Entry> current;
+    bool complete = true;
+    if (!readNames(directory, current, complete) || !complete) {
+        return kNoMtime;
+    }
+    std::vector<IndexSnapshot::Entry> listed;
+    namesOf(*listing, listed);
+    const auto byName = [](const IndexSnapshot::Entry& a, const IndexSnapshot::Entry& b) { return a.name < b.name; };
+    std::sort(current.begin(), current.end(), byName);
+    std::sort(listed.begin(), listed.end(), byName);
+    const bool same = std::equal(current.begin(), current.end(), listed.begin(), listed.end(),
+                                 [](const IndexSnapshot::Entry& a, const IndexSnapshot::Entry& b) {
+                                     return a.name == b.name && a.type == b.type;
+                                 });
+    return same ? mtime : kNoMtime;
+}
+
+void DirectoryIndex::addPath(const fs::path& path) {
+    Id parent = PathTable::kEmpty;
+    for (const auto& component : path) {
+        const std::string name = component.string();
+        const Id self = paths_.child(parent, name);
+        if (parent == PathTable::kEmpty && name == "/") {
+            parent = self;  // the root isn't listed anywhere
+            continue;
+        }
+        if (name.empty() || name == "." || name == "..") {
+            parent = self;
+            continue;
+        }
+
+        std::string_view folded = paths_.internName(foldCase(name));
+        std::string_view actual = paths_.internName(name);
+        Listing& listing = editableListing(listingOf(parent));
+        if (!listing.entries) {
+            listing.entries = std::make_unique<Entries>();
+        }
+        if (findName(*listing.entries, folded, actual) == listing.entries->end()) {
+            listing.entries->emplace(folded, Named{actual, EntryType::Other});
+        }
+        parent = self;
+    }
+
+    // Earlier misses may now resolve
+    resolved_.clear();
+}
+
+bool DirectoryIndex::refresh(const fs::path& directory, std::string_view name) {
+    const Id id = listingOf(paths_.intern(directory));
+    std::error_code ec;
+    const fs::file_status status = fs::symlink_status(directory / name, ec);
+    const bool exists = fs::exists(status);
+    std::string_view folded = paths_.internName(foldCase(name));
+    std::string_view actual = paths_.internName(name);
+
+    const DirectorySlot* slot = directories_.find(id);
+    if (!slot || !slot->listing.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    bool changed = false;
+    Listing& cached = editableListing(id);
+    if (!cached.entries) {
+        // It couldn't be read before, and now something happens inside it
+        dropListing(id);
+        changed = true;
+    } else {
+        Entries& entries = *cached.entries;
+        auto entry = findName(entries, folded, actual);
+        if (exists) {
+            changed = entry == entries.end();
+            if (changed) {
+                entries.emplace(folded, Named{actual, typeOf(status.type())});
+            } else {
+                entry->second.type = typeOf(status.type());
+            }
+        } else if (entry != entries.end()) {
+            entries.erase(entry);
+            changed = true;
+        }
+        if (changed) {
+            // No longer what the directory held at its recorded mtime
+            cached.mtime = kNoMtime;
+            cached.readMtime = kNoMtime;
+        }
+    }
+
+    if (changed) {
+        resolved_.clear();
+    }
+    return changed;
+}
+
+void DirectoryIndex::forget(const fs::path& directory) {
+    if (dropListing(listingOf(paths_.intern(directory)))) {
+        resolved_.clear();
+    }
+}
+
+fs::path DirectoryIndex::listingPath(const fs::path& directory) {
+    return paths_.toPath(listingOf(paths_.intern(directory)));
+}
+
+DirectoryIndex::Id DirectoryIndex::listingOf(Id directory) {
+    // "a/b/../c" is listed with "a/c", the way a browser resolves the URL
+    const Id normalized = paths_.normalized(directory);
+    return normalized == PathTable::kEmpty ? paths_.child(PathTable::kEmpty, ".") : normalized;
+}
+
+void DirectoryIndex::clear() {
+    dropListings();
+    resolved_.clear();
+    paths_.clear();
+    snapshot_.reset();
+}
+
+std::unique_ptr<DirectoryIndex::Entries> DirectoryIndex::makeEntries(const std::vector<IndexSnapshot::Entry>& names,
+                                                                      bool& complete) {
+    auto entries = std::make_unique<Entries>();
+    entries->reserve(names.size());
+    for (const auto& entry : names) {
+        const std::string_view folded = paths_.internName(foldCase(entry.name));
+        const std::string_view name = paths_.internName(entry.name);
+        if (findName(*entries, folded, name) != entries->end()) {
+            continue;
+        }
+        if (entries->count(folded) != 0) {
+            complete = false;
+        }
+        entries->emplace(folded, Named{name, entry.type});
+    }
+    return entries;
+}
+
+DirectoryIndex::Entries::iterator DirectoryIndex::findName(Entries& entries, std::string_view folded,
+                                                           std::string_view name) {
+    auto range = entries.equal_range(folded);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.name == name) {
+            return it;
+        }
+    }
+    return entries.end();
+}
+
+void DirectoryIndex::detachFromSnapshot(Listing& listing) {
+    if (listing.snapshot == kNotInSnapshot) {
+        return;
+    }
+    // The names stay in the mapping, which outlives every listing
+    auto entries = std::make_unique<Entries>();
+    snapshot_->forEach(listing.snapshot, [&entries](std::string_view name, std::string_view folded,
+                                                    EntryType type) {
+        entries->emplace(folded, Named{name, type});
+    });
+    listing.entries = std::move(entries);
+    listing.snapshot = kNotInSnapshot;
+}
+
+const DirectoryIndex::Listing& DirectoryIndex::listingFor(Id directory) {
+    DirectorySlot* slot = directories_.find(directory);
+    if (slot) {
+        if (const Listing* listing = slot->listing.load(std::memory_order_acquire)) {
+            return *listing;
+        }
+    }
+
+    static const Listing kUnlisted;
+    if (source_ == Source::Supplied) {
+        return kUnlisted;
+    }
+
+    if (!slot) {
+        slot = &directories_.at(directory);
+    }
+    if (!slot->claimed.exchange(true, std::memory_order_acq_rel)) {
+        std::unique_ptr<Listing> listing;
+        try {
+            listing = readListing(directory);
+        } catch (...) {
+            slot->claimed.store(false, std::memory_order_release);
+            throw;
+        }
+        Listing* published = listing.release();
+        slot->listing.store(published, std::memory_order_release);
+        return *published;
+    }
+
+    // Another thread is listing it (or the walker is publishing it) and is
+    // about to be done: waiting beats reading the same directory twice
+    const Listing* listing;
+    while (!(listing = slot->listing.load(std::memory_order_acquire))) {
+        if (!slot->claimed.load(std::memory_order_acquire)) {
+            return listingFor(directory);  // its reader failed; try again
+        }
+        std::this_thread::yield();
+    }
+    return *listing;
+}
+
+std::unique_ptr<DirectoryIndex::Listing> DirectoryIndex::readListing(Id directory) {
+    // Unreadable or missing directories get a listing without entries, so
+    // they are not retried for every reference pointing into them
+    const fs::path path = paths_.toPath(directory);
+    auto listing = std::make_unique<Listing>();
+    int64_t mtime = kNoMtime;
+    listing->snapshot = currentInSnapshot(path, mtime);
+    if (listing->snapshot != kNotInSnapshot) {
+        listing->mtime = mtime;
+        listing->readMtime = mtime;
+        return listing;
+    }
+
+    std::vector<IndexSnapshot::Entry> names;
+    bool complete = true;
+    if (!readNames(path, names, complete)) {
+        return listing;
+    }
+    listing->readMtime = complete ? mtime : kNoMtime;
+    listing->entries = makeEntries(names, complete);
+    listing->mtime = complete ? settled(mtime) : kNoMtime;
+    return listing;
+}
+
+void DirectoryIndex::namesOf(const Listing& listing, std::vector<IndexSnapshot::Entry>& names) const {
+    if (listing.snapshot != kNotInSnapshot) {
+        snapshot_->forEach(listing.snapshot, [&names](std::string_view name, std::string_view, EntryType type) {
+            names.push_back(IndexSnapshot::Entry{std::string(name), type});
+        });
+    } else if (listing.entries) {
+        for (const auto& [folded, named] : *listing.entries) {
+            names.push_back(IndexSnapshot::Entry{std::string(named.name), named.type});
+        }
+    }
+}
+
+bool DirectoryIndex::readNames(const fs::path& directory, std::vector<IndexSnapshot::Entry>& names,
+                               bool& complete) {
+    std::error_code ec;
+    fs::directory_iterator it(directory, ec);
+    if (ec) {
+        return false;
+    }
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            break;
+        }
+        // d_type, where the filesystem fills it in, answers this without a stat
+        std::error_code statusError;
+        names.push_back(IndexSnapshot::Entry{it->path().filename().string(),
+                                             typeOf(it->symlink_status(statusError).type())});
+    }
+    complete = complete && !ec;
+    return true;
+}
+
+bool DirectoryIndex::publish(Id directory, std::unique_ptr<Listing> listing) {
+    DirectorySlot& slot = directories_.at(directory);
+    if (slot.claimed.exchange(true, std::memory_order_acq_rel)) {
+        return false;  // listed already, or being listed; that copy is kept
+    }
+    slot.listing.store(listing.release(), std::memory_order_release);
+    return true;
+}
+
+DirectoryIndex::Listing& DirectoryIndex::editableListing(Id directory) {
+    DirectorySlot& slot = directories_.at(directory);
+    Listing* listing = slot.listing.load(std::memory_order_acquire);
+    if (!listing) {
+        listing = new Listing();
+        slot.listing.store(listing, std::memory_order_release);
+        slot.claimed.store(true, std::memory_order_release);
+    }
+    detachFromSnapshot(*listing);
+    return *listing;
+}
+
+bool DirectoryIndex::dropListing(Id directory) {
+    DirectorySlot* slot = directories_.find(directory);
+    if (!slot) {
+        return false;
+    }
+    std::unique_ptr<Listing> listing(slot->listing.exchange(nullptr, std::memory_order_acq_rel));
+    slot->claimed.store(false, std::memory_order_release);
+    return listing != nullptr;
+}
+
+void DirectoryIndex::dropListings() {
+    directories_.forEach([](Id, DirectorySlot& slot) {
+        delete slot.listing.exchange(nullptr, std::memory_order_acq_rel);
+        slot.claimed.store(false, std::memory_order_release);
+    });
+    directories_.clear();
+}
@@ -0,0 +1,250 @@
+// directory_index.h
+#ifndef DIRECTORY_INDEX_H
+#define DIRECTORY_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "IndexSnapshot.h"
+#include "PathTable.h"
+#include "SlotArray.h"
+
+namespace fs = std::filesystem;
+
+// Case-insensitive listing cache: every directory is read from disk once and
+// kept as a map from the case-folded filename to its on-disk name. Paths and
+// names live in a PathTable, so the caches are keyed by small IDs and every
+// name is stored once. Safe to share between threads, and lookups take no
+// lock: each directory is listed exactly once, by the first thread to need
+// it (others wait for that one rather than read it too), and the listing is
+// then published through an atomic pointer and never changes while lookups
+// may run. Resolved paths are cached the same way, one atomic word per path.
+// Listings are only modified by the calls that say they must not overlap
+// with lookups.
+//
+// Listings can also come from an IndexSnapshot saved by an earlier run:
+// a directory whose mtime still matches is looked up in the mapped snapshot
+// instead of being read again.
+class DirectoryIndex {
+public:
+    using Id = PathTable::Id;
+    using EntryType = IndexSnapshot::EntryType;
+    using VisitEntry = std::function<void(std::string_view name, EntryType type)>;
+
+    // Directory mtime as file_time_type ticks, or kNoMtime if it can't be had
+    static constexpr int64_t kNoMtime = std::numeric_limits<int64_t>::min();
+    static int64_t mtimeOf(const fs::path& directory);
+
+    // Where listings come from when a directory is first needed
+    enum class Source {
+        Disk,     // read the directory from the filesystem
+        Supplied  // only what insert()/addPath() provided; anything else doesn't exist
+    };
+
+    explicit DirectoryIndex(Source source = Source::Disk);
+    ~DirectoryIndex();
+
+    DirectoryIndex(const DirectoryIndex&) = delete;
+    DirectoryIndex& operator=(const DirectoryIndex&) = delete;
+
+    // Actual name of `name` inside `directory`, or nullopt if there is none
+    std::optional<std::string> lookup(const fs::path& directory, std::string_view name);
+
+    // Fix the case of every component of `path`; resolved prefixes are cached
+    // so sibling paths only pay for their last component
+    std::optional<fs::path> resolve(const fs::path& path);
+
+    // Same, on interned paths: kNone if `path` doesn't exist
+    Id resolve(Id path);
+
+    // Take `path` and every directory above it as spelled on disk, so that
+    // resolving paths below it never lists them: for the directory a page
+    // was found in, whose ancestors may not even be listable (an
+    // execute-only /home) or may have siblings that fold alike. Paths
+    // found already are left as they are.
+    void trust(Id path);
+
+    // Append the directories whose listings decided the resolution of `path`
+    // (which must have been resolved already), innermost first
+    void dependencies(Id path, std::vector<fs::path>& directories) const;
+
+    // Publish a listing read elsewhere (e.g. during file discovery); an
+    // existing listing for `directory` is kept
+    void insert(const fs::path& directory, const std::vector<std::string>& names);
+
+    // Same, with the type of each entry and the directory's mtime from just
+    // before it was read, so that the listing can go into a snapshot
+    void insert(const fs::path& directory, const std::vector<IndexSnapshot::Entry>& entries, int64_t mtime);
+
+    // Take each directory's mtime before reading it, as saveSnapshot()
+    // needs (default: off, which saves a stat per directory)
+    void setRecordMtimes(bool record);
+    bool recordsMtimes() const { return recordMtimes_; }
+
+    // Serve listings from the snapshot at `path` wherever the directory's
+    // mtime still matches. A missing or invalid snapshot is ignored and
+    // returns false; that just means every directory is read. Drops every
+    // cached listing, so it must not run concurrently with lookups.
+    bool loadSnapshot(const fs::path& path);
+
+    // If the loaded snapshot holds a listing of `directory` that is still
+    // current, publish it and call `visit` for each of its entries. `mtime`
+    // receives the directory's mtime either way, for a listing the caller
+    // then reads itself.
+    bool reuseSnapshot(const fs::path& directory, int64_t& mtime, const VisitEntry& visit);
+
+    // Write every listing whose directory still has the mtime it was read
+    // at, plus the loaded snapshot's listings this run didn't touch (throws
+    // std::runtime_error). Listings that can't be vouched for, such as
+    // directories changed while or since they were read, are left out and
+    // simply read again next time.
+    void saveSnapshot(const fs::path& path) const;
+
+    // Mtime of `directory` (spelled as dependencies() reports it) that its
+    // listing from this run can be vouched for at: the one taken before it
+    // was read, or, if the directory has changed since but still holds the
+    // same entries (as after this run's own atomic replaces), the one taken
+    // before reading it again to compare. kNoMtime if it can't be vouched
+    // for, nullopt if it wasn't listed. Needs setRecordMtimes(true); not
+    // concurrently with lookups.
+    std::optional<int64_t> listedMtime(const fs::path& directory);
+
+    // Record that `path` exists, adding each of its components to its
+    // parent's listing; relative paths are listed under ".". Meant for
+    // building a Supplied index from an external listing (an object store,
+    // an archive). Like refresh() and forget(), which edit listings in
+    // place, it must not run concurrently with lookups.
+    void addPath(const fs::path& path);
+
+    // Bring the cached listing of `directory` up to date with whether `name`
+    // now exists on disk. Returns true if the listing changed; a listing
+    // that was never read is left to be read when first needed.
+    bool refresh(const fs::path& directory, std::string_view name);
+
+    // Drop the cached listing of `directory`, to be read again when needed
+    void forget(const fs::path& directory);
+
+    // Path the listing of `directory` is kept under ("a/b/../c" -> "a/c"),
+    // as the paths reported by dependencies() spell it
+    fs::path listingPath(const fs::path& directory);
+
+    // Forget every cached listing, interned path and loaded snapshot; not
+    // concurrently with anything else
+    void clear();
+
+    PathTable& paths() { return paths_; }
+
+private:
+    struct Named {
+        std::string_view name;
+        EntryType type;
+    };
+
+    // Folded name -> on-disk name, both interned in paths_ (or in the
+    // snapshot's mapping). Names that fold alike each keep an entry.
+    using Entries = std::unordered_multimap<std::string_view, Named>;
+
+    static constexpr uint32_t kNotInSnapshot = IndexSnapshot::kNotFound;
+
+    struct Listing {
+        std::unique_ptr<Entries> entries;    // null if unreadable or served by the snapshot
+        uint32_t snapshot = kNotInSnapshot;  // listing of snapshot_ that answers lookups
+        int64_t mtime = kNoMtime;            // taken just before the listing was read
+        int64_t readMtime = kNoMtime;        // same, however recent; for listedMtime()
+    };
+
+    // One per directory ID. `claimed` is the directory's once-flag: the
+    // thread that sets it lists the directory and publishes the result.
+    struct DirectorySlot {
+        std::atomic<Listing*> listing{nullptr};
+        std::atomic<bool> claimed{false};
+    };
+
+    struct Resolution {
+        Id actual;  // on-disk case, or kNone if it doesn't exist
+        Id listed;  // directory searched for the last component, or kNone
+    };
+
+    // A Resolution packed into one word. No resolution packs to 0 (its
+    // `listed` is never the empty path), so a fresh slot reads as unresolved.
+    struct ResolutionSlot {
+        std::atomic<uint64_t> packed{0};
+
+        bool load(Resolution& resolution) const;
+        void store(const Resolution& resolution);
+    };
+
+    // Listing for `directory`, read on first use
+    const Listing& listingFor(Id directory);
+
+    // Read `directory` from disk, or find it in the snapshot
+    std::unique_ptr<Listing> readListing(Id directory);
+
+    // Publish `listing` for `directory` unless another thread has claimed
+    // the directory first; returns whether it was published
+    bool publish(Id directory, std::unique_ptr<Listing> listing);
+
+    // Listing of `directory` to be edited in place, created empty if it was
+    // never read; only where lookups can't run
+    Listing& editableListing(Id directory);
+
+    // Drop the listing of `directory` (true if there was one), or of every
+    // directory, leaving them to be read again
+    bool dropListing(Id directory);
+    void dropListings();
+
+    // Listing of the loaded snapshot that is still current for `directory`,
+    // or kNotInSnapshot; `mtime` receives the directory's mtime when a
+    // snapshot is loaded or mtimes are recorded, and kNoMtime otherwise
+    uint32_t currentInSnapshot(const fs::path& directory, int64_t& mtime) const;
+
+    // Names and types in `directory`; `complete` turns false if reading
+    // stopped early. Returns false if the directory can't be opened.
+    static bool readNames(const fs::path& directory, std::vector<IndexSnapshot::Entry>& names, bool& complete);
+
+    // Append the names and types `listing` holds, wherever it keeps them
+    void namesOf(const Listing& listing, std::vector<IndexSnapshot::Entry>& names) const;
+
+    // Give a snapshot-backed listing entries of its own, to be edited
+    void detachFromSnapshot(Listing& listing);
+
+    // Node whose listing holds the entries of `directory`
+    Id listingOf(Id directory);
+
+    // Entry of `name` itself among those filed under `folded`, or end()
+    static Entries::iterator findName(Entries& entries, std::string_view folded, std::string_view name);
+
+    // Entries of `names`; `complete` turns false if two of them fold alike,
+    // as on a case-sensitive filesystem, since a snapshot keeps only one
+    std::unique_ptr<Entries> makeEntries(const std::vector<IndexSnapshot::Entry>& names, bool& complete);
+
+    // `mtime`, unless it is too recent to prove the listing read after it
+    // complete: a change in the same clock tick wouldn't move it
+    static int64_t settled(int64_t mtime);
+
+    // Interned on-disk name of `name` inside `directory`, if there is one
+    std::optional<std::string_view> lookup(Id directory, std::string_view name);
+
+    Source source_;
+    PathTable paths_;
+
+    bool recordMtimes_ = false;
+    std::unique_ptr<IndexSnapshot> snapshot_;
+
+    // Indexed by the directory's (normalized) ID
+    SlotArray<DirectorySlot> directories_;
+
+    // Indexed by the ID of the path as written: the outcome of resolving it
+    SlotArray<ResolutionSlot> resolved_;
+};
+
+#endif // DIRECTORY_INDEX_H
@@ -0,0 +1,329 @@
+#include "DirectoryWalker.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HTML_CASE_CORRECTOR_HAVE_GETDENTS 1
+#endif
+
+struct DirectoryWalker::Listing {
+    fs::path directory;
+    std::vector<fs::path> files;        // regular files that passed the filter
+    std::vector<fs::path> directories;  // subdirectories to descend into
+    std::error_code error;
+};
+
+// directory_walker.cpp
+DirectoryWalker::DirectoryWalker(unsigned threads, DirectoryIndex* index)
+    : threads_(threads), index_(index) {
+}
+
+void DirectoryWalker::setTopLevelFilter(TopLevelFilter keep) {
+    topLevel_ = std::move(keep);
+}
+
+void DirectoryWalker::prune(Listing& listing) const {
+    if (!topLevel_) {
+        return;
+    }
+    auto rejected = [this](bool isDirectory) {
+        return [this, isDirectory](const fs::path& path) {
+            return !topLevel_(path.filename().string(), isDirectory);
+        };
+    };
+    listing.files.erase(std::remove_if(listing.files.begin(), listing.files.end(), rejected(false)),
+                        listing.files.end());
+    listing.directories.erase(std::remove_if(listing.directories.begin(), listing.directories.end(),
+                                             rejected(true)),
+                              listing.directories.end());
+}
+
+void DirectoryWalker::walk(const fs::path& root, const Filter& filter, const Visit& visit) {
+    if (threads_ <= 1) {
+        walkSequential(root, filter, visit);
+    } else {
+        walkParallel(root, filter, visit);
+    }
+}
+
+void DirectoryWalker::walkSequential(const fs::path& root, const Filter& filter, const Visit& visit) {
+    std::vector<fs::path> pending{root};
+    while (!pending.empty()) {
+        Listing listing;
+        listing.directory = std::move(pending.back());
+        pending.pop_back();
+
+        if (!list(listing.directory, filter, listing)) {
+            if (listing.directory == root) {
+                throw fs::filesystem_error("Cannot read directory", root, listing.error);
+            }
+            continue;
+        }
+        if (listing.directory == root) {
+            prune(listing);
+        }
+        for (const auto& file : listing.files) {
+            visit(file);
+        }
+        for (auto& directory : listing.directories) {
+            pending.push_back(std::move(directory));
+        }
+    }
+}
+
+void DirectoryWalker::walkParallel(const fs::path& root, const Filter& filter, const Visit& visit) {
+    // Listing threads pull directories from `pending` and push what they
+    // found onto `ready`; the calling thread drains `ready` and runs the
+    // visitor, so the visitor never needs to be thread-safe.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<fs::path> pending{root};
+    std::deque<Listing> ready;
+    size_t outstanding = 1;  // directories queued or being listed
+    bool stopping = false;
+
+    auto listDirectories = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [&] {
+                return stopping || outstanding == 0 ||
+                       (!pending.empty() && ready.size() < kMaxQueuedListings);
+            });
+            if (stopping || outstanding == 0) {
+                return;
+            }
+
+            Listing listing;
+            listing.directory = std::move(pending.front());
+            pending.pop_front();
+            lock.unlock();
+            bool listed = list(listing.directory, filter, listing);
+            if (listed && listing.directory == root) {
+                prune(listing);
+            }
+            lock.lock();
+
+            for (auto& directory : listing.directories) {
+                pending.push_back(std::move(directory));
+            }
+            outstanding += listing.directories.size();
+            --outstanding;
+            listing.directories.clear();
+            if (listed || listing.directory == root) {
+                ready.push_back(std::move(listing));
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    struct JoinOnExit {
+        std::vector<std::thread>& threads;
+        std::mutex& mutex;
+        std::condition_variable& changed;
+        bool& stopping;
+        ~JoinOnExit() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+    } joinOnExit{threads, mutex, changed, stopping};
+
+    for (unsigned i = 0; i < threads_; ++i) {
+        threads.emplace_back(listDirectories);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        changed.wait(lock, [&] { return !ready.empty() || outstanding == 0; });
+        if (ready.empty()) {
+            return;
+        }
+
+        Listing listing = std::move(ready.front());
+        ready.pop_front();
+        changed.notify_all();
+        lock.unlock();
+
+        if (listing.error && listing.directory == root) {
+            throw fs::filesystem_error("Cannot read directory", root, listing.error);
+        }
+        for (const auto& file : listing.files) {
+            visit(file);
+        }
+        lock.lock();
+    }
+}
+
+bool DirectoryWalker::listFromSnapshot(const fs::path& directory, const Filter& filter, Listing& listing,
+                                       int64_t& mtime) const {
+    mtime = DirectoryIndex::kNoMtime;
+    if (!index_) {
+        return false;
+    }
+    using EntryType = DirectoryIndex::EntryType;
+    return index_->reuseSnapshot(directory, mtime, [&](std::string_view name, EntryType type) {
+        if (type == EntryType::Directory) {
+            listing.directories.push_back(directory / name);
+        } else if ((type == EntryType::File || type == EntryType::Symlink) && filter(name)) {
+            // Where a link leads isn't part of the directory, so it is looked up now
+            std::error_code ec;
+            fs::path file = directory / name;
+            if (type == EntryType::File || fs::is_regular_file(file, ec)) {
+                listing.files.push_back(std::move(file));
+            }
+        }
+    });
+}
+
+#ifdef HTML_CASE_CORRECTOR_HAVE_GETDENTS
+
+namespace {
+// Record layout returned by getdents64; glibc only exposes it through readdir
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+constexpr size_t kDirentBatchBytes = 64 * 1024;
+
+struct FileDescriptor {
+    int fd;
+    ~FileDescriptor() { ::close(fd); }
+};
+}
+
+bool DirectoryWalker::list(const fs::path& directory, const Filter& filter, Listing& listing) const {
+    int64_t mtime = DirectoryIndex::kNoMtime;
+    if (listFromSnapshot(directory, filter, listing, mtime)) {
+        return true;
+    }
+
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        listing.error = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    FileDescriptor closeOnExit{fd};
+
+    // One buffer per listing thread, reused across directories
+    thread_local std::vector<char> batch(kDirentBatchBytes);
+    std::vector<IndexSnapshot::Entry> names;
+
+    for (;;) {
+        const long bytes = ::syscall(SYS_getdents64, fd, batch.data(), batch.size());
+        if (bytes < 0) {
+            listing.error = std::error_code(errno, std::generic_category());
+            return false;
+        }
+        if (bytes == 0) {
+            break;
+        }
+
+        for (long position = 0; position < bytes;) {
+            const auto* entry = reinterpret_cast<const LinuxDirent64*>(batch.data() + position);
+            position += entry->d_reclen;
+
+            const std::string_view name(entry->d_name);
+            if (name == "." || name == "..") {
+                continue;
+            }
+            names.push_back(IndexSnapshot::Entry{std::string(name), IndexSnapshot::EntryType::Other});
+
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (::fstatat(fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG
+                     : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+            }
+            names.back().type = type == DT_DIR ? IndexSnapshot::EntryType::Directory
+                              : type == DT_REG ? IndexSnapshot::EntryType::File
+                              : type == DT_LNK ? IndexSnapshot::EntryType::Symlink
+                              : IndexSnapshot::EntryType::Other;
+
+            if (type == DT_DIR) {
+                listing.directories.push_back(directory / name);
+            } else if ((type == DT_REG || type == DT_LNK) && filter(name)) {
+                // A link is only reported when it leads to a regular file
+                struct stat st;
+                if (type == DT_REG || (::fstatat(fd, entry->d_name, &st, 0) == 0 && S_ISREG(st.st_mode))) {
+                    listing.files.push_back(directory / name);
+                }
+            }
+        }
+    }
+
+    if (index_) {
+        index_->insert(directory, names, mtime);
+    }
+    return true;
+}
+
+#else
+
+bool DirectoryWalker::list(const fs::path& directory, const Filter& filter, Listing& listing) const {
+    int64_t mtime = DirectoryIndex::kNoMtime;
+    if (listFromSnapshot(directory, filter, listing, mtime)) {
+        return true;
+    }
+
+    std::vector<IndexSnapshot::Entry> names;
+    fs::directory_iterator it(directory, listing.error);
+    if (listing.error) {
+        return false;
+    }
+
+    std::error_code ec;
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            break;
+        }
+        std::string name = it->path().filename().string();
+        IndexSnapshot::EntryType type = IndexSnapshot::EntryType::Other;
+        if (it->is_symlink(ec)) {
+            type = IndexSnapshot::EntryType::Symlink;
+        } else if (it->is_directory(ec)) {
+            type = IndexSnapshot::EntryType::Directory;
+        } else if (it->is_regular_file(ec)) {
+            type = IndexSnapshot::EntryType::File;
+        }
+        if (type == IndexSnapshot::EntryType::Directory) {
+            listing.directories.push_back(it->path());
+        } else if (filter(name) && it->is_regular_file(ec)) {
+            listing.files.push_back(it->path());
+        }
+        names.push_back(IndexSnapshot::Entry{std::move(name), type});
+    }
+
+    if (index_) {
+        index_->insert(directory, names, mtime);
+    }
+    return true;
+}
+
+#endif // HTML_CASE_CORRECTOR_HAVE_GETDENTS
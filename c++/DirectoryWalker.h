@@ -0,0 +1,70 @@
+// directory_walker.h
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+
+#include "DirectoryIndex.h"
+
+namespace fs = std::filesystem;
+
+// Recursive file discovery that reads each directory once, in large
+// getdents64 batches, and trusts d_type so that regular files and
+// subdirectories only need a stat when the filesystem leaves d_type unset.
+// With more than one thread, independent subtrees are listed in parallel.
+// Every listing is also published into a DirectoryIndex, so reference
+// resolution later finds the directory already cached; a directory the
+// index's snapshot still describes isn't read at all.
+//
+// Matches recursive_directory_iterator's defaults: symlinks to files are
+// reported, symlinks to directories are not followed.
+class DirectoryWalker {
+public:
+    using Filter = std::function<bool(std::string_view name)>;
+    using Visit = std::function<void(const fs::path&)>;
+    using TopLevelFilter = std::function<bool(std::string_view name, bool isDirectory)>;
+
+    // `index` may be null; `threads` <= 1 lists on the calling thread
+    DirectoryWalker(unsigned threads, DirectoryIndex* index);
+
+    // Call `visit` for every regular file under `root` whose name passes
+    // `filter`. `visit` always runs on the calling thread, one file at a time.
+    // Throws fs::filesystem_error if `root` can't be read; unreadable
+    // subdirectories are skipped.
+    void walk(const fs::path& root, const Filter& filter, const Visit& visit);
+
+    // Descend only into the root's subdirectories that `keep` accepts, and
+    // visit only the root's own files it accepts; nothing below a rejected
+    // subdirectory is listed. The root's listing still reaches the index
+    // in full.
+    void setTopLevelFilter(TopLevelFilter keep);
+
+    // Listings handed back to the caller but not yet visited, in parallel mode
+    static constexpr size_t kMaxQueuedListings = 256;
+
+private:
+    struct Listing;
+
+    // Read one directory; returns false if it couldn't be opened
+    bool list(const fs::path& directory, const Filter& filter, Listing& listing) const;
+
+    // Take the listing from the index's snapshot when it is still current;
+    // `mtime` receives the directory's mtime for the index either way
+    bool listFromSnapshot(const fs::path& directory, const Filter& filter, Listing& listing,
+                          int64_t& mtime) const;
+
+    // Apply the top-level filter to the root's listing
+    void prune(Listing& listing) const;
+
+    void walkSequential(const fs::path& root, const Filter& filter, const Visit& visit);
+    void walkParallel(const fs::path& root, const Filter& filter, const Visit& visit);
+
+    unsigned threads_;
+    DirectoryIndex* index_;
+    TopLevelFilter topLevel_;
+};
+
+#endif // DIRECTORY_WALKER_H
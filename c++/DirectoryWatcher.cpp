@@ -0,0 +1,222 @@
+#include "DirectoryWatcher.h"
+
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#define HTML_CASE_CORRECTOR_HAVE_INOTIFY 1
+#endif
+
+// directory_watcher.cpp
+#ifdef HTML_CASE_CORRECTOR_HAVE_INOTIFY
+
+namespace {
+// IN_CLOSE_WRITE rather than IN_MODIFY: a page is only worth reading once
+// the writer is done with it
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                IN_CLOSE_WRITE | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+bool isWithin(const std::string& path, const std::string& directory) {
+    return path.size() >= directory.size() && path.compare(0, directory.size(), directory) == 0 &&
+           (path.size() == directory.size() || path[directory.size()] == '/');
+}
+}
+
+std::unique_ptr<DirectoryWatcher> DirectoryWatcher::create(const fs::path& root, TopLevelFilter keep) {
+    int inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        return nullptr;
+    }
+    int stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0) {
+        ::close(inotifyFd);
+        return nullptr;
+    }
+
+    // "site/" and "site" must name the same directory in events
+    fs::path watchedRoot = root.has_filename() || !root.has_parent_path() ? root : root.parent_path();
+    std::unique_ptr<DirectoryWatcher> watcher(new DirectoryWatcher(inotifyFd, stopFd, watchedRoot, std::move(keep)));
+    watcher->addTree(watchedRoot, nullptr);
+    return watcher;
+}
+
+DirectoryWatcher::DirectoryWatcher(int inotifyFd, int stopFd, fs::path root, TopLevelFilter keep)
+    : inotifyFd_(inotifyFd), stopFd_(stopFd), root_(std::move(root)), keep_(std::move(keep)) {
+}
+
+bool DirectoryWatcher::follows(const fs::path& parent, const std::string& name) const {
+    return !keep_ || parent != root_ || keep_(name, true);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    ::close(inotifyFd_);
+    ::close(stopFd_);
+}
+
+void DirectoryWatcher::addTree(const fs::path& directory, std::vector<Event>* report, Event::Kind kind) {
+    std::vector<fs::path> pending{directory};
+    while (!pending.empty()) {
+        fs::path current = std::move(pending.back());
+        pending.pop_back();
+
+        int wd = ::inotify_add_watch(inotifyFd_, current.c_str(), kWatchMask);
+        if (wd < 0) {
+            if (errno == ENOSPC) {
+                throw std::runtime_error("Cannot watch " + current.string() +
+                                         ": inotify watch limit reached (fs.inotify.max_user_watches)");
+            }
+            if (current == directory && !report) {
+                throw fs::filesystem_error("Cannot watch directory", current,
+                                           std::error_code(errno, std::generic_category()));
+            }
+            continue;  // gone again, or unreadable: nothing to correct in it
+        }
+
+        // A directory moved back in keeps its inode, and with it the old descriptor
+        auto previous = directories_.find(wd);
+        if (previous != directories_.end()) {
+            watches_.erase(previous->second.string());
+        }
+        directories_[wd] = current;
+        watches_[current.string()] = wd;
+
+        std::error_code ec;
+        for (fs::directory_iterator it(current, ec), end; !ec && it != end; it.increment(ec)) {
+            const bool isDirectory = fs::is_directory(it->symlink_status(ec));
+            if (ec) {
+                ec.clear();
+                continue;
+            }
+            // A file found here may have been closed before the watch existed,
+            // so no Written event will come for it
+            const std::string name = it->path().filename().string();
+            if (report) {
+                report->push_back({isDirectory ? kind : Event::Kind::MovedIn, current, name, isDirectory});
+            }
+            if (isDirectory && follows(current, name)) {
+                pending.push_back(it->path());
+            }
+        }
+    }
+}
+
+void DirectoryWatcher::removeTree(const fs::path& directory) {
+    const std::string prefix = directory.string();
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        if (!isWithin(it->first, prefix)) {
+            ++it;
+            continue;
+        }
+        ::inotify_rm_watch(inotifyFd_, it->second);
+        directories_.erase(it->second);
+        it = watches_.erase(it);
+    }
+}
+
+bool DirectoryWatcher::wait(std::vector<Event>& events) {
+    pollfd fds[2] = {{stopFd_, POLLIN, 0}, {inotifyFd_, POLLIN, 0}};
+    for (;;) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Cannot wait for directory changes");
+        }
+        if (fds[0].revents & POLLIN) {
+            return false;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+    }
+
+    // Drain everything queued so a burst of uploads becomes one batch
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t length = ::read(inotifyFd_, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return true;
+            }
+            throw std::runtime_error("Cannot read directory changes");
+        }
+        decode(buffer, static_cast<size_t>(length), events);
+    }
+}
+
+void DirectoryWatcher::stop() {
+    const uint64_t one = 1;
+    // Only fails if the counter would overflow, and then it is already set
+    [[maybe_unused]] ssize_t written = ::write(stopFd_, &one, sizeof(one));
+}
+
+void DirectoryWatcher::decode(const char* buffer, size_t length, std::vector<Event>& events) {
+    for (size_t offset = 0; offset < length;) {
+        const auto* record = reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += sizeof(inotify_event) + record->len;
+
+        if (record->mask & IN_Q_OVERFLOW) {
+            events.push_back({Event::Kind::Overflow, {}, {}, false});
+            continue;
+        }
+        auto watched = directories_.find(record->wd);
+        if (watched == directories_.end()) {
+            continue;  // queued before its directory was dropped
+        }
+        const fs::path directory = watched->second;
+        if (record->mask & IN_IGNORED) {
+            auto watch = watches_.find(directory.string());
+            if (watch != watches_.end() && watch->second == record->wd) {
+                watches_.erase(watch);
+            }
+            directories_.erase(watched);
+            continue;
+        }
+        if (record->len == 0) {
+            continue;
+        }
+
+        const std::string name = record->name;
+        const bool isDirectory = (record->mask & IN_ISDIR) != 0;
+        if (record->mask & IN_CREATE) {
+            events.push_back({Event::Kind::Created, directory, name, isDirectory});
+            if (isDirectory && follows(directory, name)) {
+                addTree(directory / name, &events, Event::Kind::Created);
+            }
+        } else if (record->mask & IN_MOVED_TO) {
+            events.push_back({Event::Kind::MovedIn, directory, name, isDirectory});
+            if (isDirectory && follows(directory, name)) {
+                addTree(directory / name, &events);
+            }
+        } else if (record->mask & IN_DELETE) {
+            events.push_back({Event::Kind::Removed, directory, name, isDirectory});
+        } else if (record->mask & IN_MOVED_FROM) {
+            events.push_back({Event::Kind::Removed, directory, name, isDirectory});
+            if (isDirectory) {
+                removeTree(directory / name);
+            }
+        } else if (record->mask & IN_CLOSE_WRITE) {
+            events.push_back({Event::Kind::Written, directory, name, isDirectory});
+        }
+    }
+}
+
+#else // !HTML_CASE_CORRECTOR_HAVE_INOTIFY
+
+std::unique_ptr<DirectoryWatcher> DirectoryWatcher::create(const fs::path&, TopLevelFilter) {
+    return nullptr;
+}
+
+DirectoryWatcher::~DirectoryWatcher() = default;
+bool DirectoryWatcher::wait(std::vector<Event>&) { return false; }
+void DirectoryWatcher::stop() {}
+
+#endif // HTML_CASE_CORRECTOR_HAVE_INOTIFY
@@ -0,0 +1,85 @@
+// directory_watcher.h
+#ifndef DIRECTORY_WATCHER_H
+#define DIRECTORY_WATCHER_H
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Recursive inotify watch over a tree. Every directory under the root gets
+// its own watch; directories that appear later are watched as they arrive,
+// and their contents are reported as they are found, since anything created
+// before the watch was added produced no event. Files found that way are
+// reported as MovedIn, since their close may already have gone unseen; one
+// still being written is reported again as Written when it is closed.
+// Symlinked directories are not followed, as in DirectoryWalker.
+class DirectoryWatcher {
+public:
+    // Same contract as DirectoryWalker::TopLevelFilter
+    using TopLevelFilter = std::function<bool(std::string_view name, bool isDirectory)>;
+
+    struct Event {
+        enum class Kind {
+            Created,   // a name appeared; a file may still be being written
+            Removed,   // a name was deleted or moved away
+            MovedIn,   // a name appeared complete (renamed into place)
+            Written,   // a file opened for writing was closed
+            Overflow   // the kernel dropped events; anything may have changed
+        };
+        Kind kind;
+        fs::path directory;  // directory holding the entry, as watched
+        std::string name;    // entry inside it; empty for Overflow
+        bool isDirectory = false;
+    };
+
+    // nullptr when the platform has no inotify. Throws std::runtime_error if
+    // the root can't be watched or the watch limit is reached. With `keep`,
+    // only the directories directly under the root it keeps are watched;
+    // events for the root's own entries are still reported.
+    static std::unique_ptr<DirectoryWatcher> create(const fs::path& root, TopLevelFilter keep = {});
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Block until something changes, then append every event that is ready.
+    // Returns false, with nothing appended, once stop() has been called.
+    bool wait(std::vector<Event>& events);
+
+    // Make wait() return false; safe from any thread and async-signal-safe
+    void stop();
+
+    // Directories currently watched
+    size_t size() const { return directories_.size(); }
+
+private:
+    DirectoryWatcher(int inotifyFd, int stopFd, fs::path root, TopLevelFilter keep);
+
+    // Should directory `name` inside `parent` be watched?
+    bool follows(const fs::path& parent, const std::string& name) const;
+
+    // Watch `directory` and everything below it. With `report`, every entry
+    // found is appended as an event: directories of `kind`, files MovedIn.
+    void addTree(const fs::path& directory, std::vector<Event>* report, Event::Kind kind = Event::Kind::MovedIn);
+
+    // Drop the watches of `directory` and everything below it
+    void removeTree(const fs::path& directory);
+
+    // Turn the raw records in `buffer` into events
+    void decode(const char* buffer, size_t length, std::vector<Event>& events);
+
+    int inotifyFd_;
+    int stopFd_;
+    fs::path root_;
+    TopLevelFilter keep_;
+    std::unordered_map<int, fs::path> directories_;  // watch descriptor -> directory
+    std::unordered_map<std::string, int> watches_;   // directory -> watch descriptor
+};
+
+#endif // DIRECTORY_WATCHER_H
@@ -1,140 +1,1081 @@
 #include "HtmlCaseCorrector.h"
+#include "AsyncReader.h"
+#include "AttributeScanner.h"
+#include "BumpArena.h"
+#include "CaseFolding.h"
+#include "DirectoryWalker.h"
+#include "Manifest.h"
+#include "MappedFile.h"
+#include "Prefilter.h"
+#include "ReverseIndex.h"
+#include "RewriteReport.h"
+#include "RunStats.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+
+namespace {
+// Append the first `length` bytes of `file` to `out`, a window at a time
+void copyFront(const fs::path& file, uint64_t length, AtomicWriter::Replacement& out) {
+    std::ifstream in(file, std::ios::binary);
+    std::string buffer(HtmlCaseCorrector::kStreamWindowBytes, '\0');
+    while (length > 0) {
+        const size_t want = static_cast<size_t>(std::min<uint64_t>(length, buffer.size()));
+        if (!in.read(buffer.data(), static_cast<std::streamsize>(want))) {
+            throw std::runtime_error("Cannot read file: " + file.string());
+        }
+        out.append(std::string_view(buffer.data(), want));
+        length -= want;
+    }
+}
+}
 
 // html_case_corrector.cpp
+HtmlCaseCorrector::HtmlCaseCorrector()
+    : writer_(std::make_unique<AtomicWriter>()) {
+}
+
+HtmlCaseCorrector::~HtmlCaseCorrector() = default;
+
 void HtmlCaseCorrector::processDirectory(const fs::path& startDir) {
-    for (const auto& htmlFile : findHtmlFiles(startDir)) {
+    const auto started = std::chrono::steady_clock::now();
+    if (stats_) {
+        stats_->reset();
+    }
+    directoryIndex_.clear();
+    referenceCache_.clear();
+    runRoot_ = startDir;
+    if (!snapshotPath_.empty()) {
+        directoryIndex_.loadSnapshot(snapshotPath_);
+    }
+    directoryIndex_.trust(directoryIndex_.paths().intern(startDir));
+    if (tracksManifest()) {
+        manifest_->load(manifestPath_);
+    }
+
+    runFiles(startDir);
+
+    if (tracksManifest()) {
+        saveManifest();
+    }
+    if (!snapshotPath_.empty()) {
+        directoryIndex_.saveSnapshot(snapshotPath_);
+    }
+    if (report_) {
+        report_->flush();
+    }
+    writer_->flush();
+    recordWallTime(started);
+}
+
+void HtmlCaseCorrector::watch(const fs::path& startDir) {
+    // Other shards' subtrees are neither watched nor listed
+    std::unique_ptr<DirectoryWatcher> watcher = DirectoryWatcher::create(startDir, shardFilter());
+    if (!watcher) {
+        throw std::runtime_error("Watch mode needs inotify, which this platform doesn't have");
+    }
+    {
+        std::lock_guard<std::mutex> lock(watchMutex_);
+        if (stopRequested_) {
+            stopRequested_ = false;
+            return;
+        }
+        watcher_ = watcher.get();
+    }
+    struct WatchReset {
+        HtmlCaseCorrector& corrector;
+        ~WatchReset() {
+            std::lock_guard<std::mutex> lock(corrector.watchMutex_);
+            corrector.watcher_ = nullptr;
+            corrector.stopRequested_ = false;
+            corrector.readPages_ = false;
+            corrector.reverseIndex_.reset();
+            corrector.watchPool_.reset();
+        }
+    } resetOnExit{*this};
+
+    readPages_ = true;
+    watchPool_ = makePool(processingJobs());
+
+    // The watches are in place before the first pass, so nothing uploaded
+    // while it runs goes unnoticed
+    reverseIndex_ = std::make_unique<ReverseIndex>();
+    processDirectory(startDir);
+
+    std::vector<DirectoryWatcher::Event> events;
+    while (watcher->wait(events)) {
+        processChanges(startDir, events);
+        events.clear();
+    }
+
+    // Batches only record into the manifest; it is saved once, on the way out
+    if (tracksManifest()) {
+        saveManifest();
+    }
+    if (!snapshotPath_.empty()) {
+        directoryIndex_.saveSnapshot(snapshotPath_);
+    }
+}
+
+void HtmlCaseCorrector::stopWatching() {
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    stopRequested_ = true;
+    if (watcher_) {
+        watcher_->stop();
+    }
+}
+
+void HtmlCaseCorrector::processAffected(const fs::path& startDir, const std::vector<fs::path>& changed) {
+    const auto started = std::chrono::steady_clock::now();
+    if (stats_) {
+        stats_->reset();
+    }
+    if (!manifest_) {
+        throw std::runtime_error("Finding affected pages needs the manifest of an earlier run");
+    }
+    // Read once, into the manifest this run updates; a dry run leaves that
+    // one alone and only reads the file to find the pages
+    Manifest dryRunManifest;
+    Manifest& previous = tracksManifest() ? *manifest_ : dryRunManifest;
+    previous.load(manifestPath_);
+    std::vector<fs::path> pages = affectedPages(previous, changed);
+
+    directoryIndex_.clear();
+    referenceCache_.clear();
+    runRoot_ = startDir;
+    if (!snapshotPath_.empty()) {
+        directoryIndex_.loadSnapshot(snapshotPath_);
+    }
+    directoryIndex_.trust(directoryIndex_.paths().intern(startDir));
+    pages.erase(std::remove_if(pages.begin(), pages.end(),
+                               [this](const fs::path& page) { return !inShard(page); }),
+                pages.end());
+
+    correctPages(pages);
+
+    if (tracksManifest()) {
+        manifest_->carryOver();
+        saveManifest();
+    }
+    if (!snapshotPath_.empty()) {
+        directoryIndex_.saveSnapshot(snapshotPath_);
+    }
+    if (report_) {
+        report_->flush();
+    }
+    writer_->flush();
+    recordWallTime(started);
+}
+
+std::vector<fs::path> HtmlCaseCorrector::affectedPages(const std::vector<fs::path>& changed) const {
+    if (!manifest_) {
+        throw std::runtime_error("Finding affected pages needs the manifest of an earlier run");
+    }
+
+    Manifest previous;
+    previous.load(manifestPath_);
+    return affectedPages(previous, changed);
+}
+
+std::vector<fs::path> HtmlCaseCorrector::affectedPages(const Manifest& previous,
+                                                       const std::vector<fs::path>& changed) {
+    ReverseIndex reverse;
+    previous.forEachPrevious([&reverse](const std::string& htmlFile, const Manifest::FileEntry& entry) {
+        reverse.record(htmlFile, entry.dependencies);
+    });
+
+    std::vector<fs::path> pages;
+    for (const auto& path : changed) {
+        std::vector<fs::path> affected = reverse.affectedBy(path);
+        pages.insert(pages.end(), affected.begin(), affected.end());
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    return pages;
+}
+
+void HtmlCaseCorrector::processChanges(const fs::path& startDir,
+                                       const std::vector<DirectoryWatcher::Event>& events) {
+    using Kind = DirectoryWatcher::Event::Kind;
+
+    std::vector<fs::path> pages;
+    std::unordered_set<std::string> queued;
+    auto queue = [&](fs::path page) {
+        if (queued.insert(page.string()).second) {
+            pages.push_back(std::move(page));
+        }
+    };
+
+    // Listings are patched by name, against what is on disk now rather than
+    // what each event says, so a temporary file created and renamed away
+    // within the batch leaves its directory's listing unchanged
+    std::unordered_set<std::string> changedListings;
+    for (const auto& event : events) {
+        if (event.kind == Kind::Overflow) {
+            // No telling which listings changed: start over
+            reverseIndex_->clear();
+            processDirectory(startDir);
+            return;
+        }
+
+        const fs::path path = event.directory / event.name;
+        if (event.kind != Kind::Written && directoryIndex_.refresh(event.directory, event.name)) {
+            changedListings.insert(directoryIndex_.listingPath(event.directory).string());
+        }
+        if (event.isDirectory) {
+            // A listing cached before the directory was replaced is stale
+            if (event.kind != Kind::Removed) {
+                directoryIndex_.forget(path);
+            }
+            continue;
+        }
+        if (!isHtmlName(event.name) || !inShard(path)) {
+            continue;
+        }
+
+        // A page that was merely created may still be being written; its
+        // close, or the rename that publishes it, queues it
+        if (event.kind == Kind::Removed) {
+            reverseIndex_->erase(path);
+        } else if (event.kind == Kind::MovedIn || event.kind == Kind::Written) {
+            queue(path);
+        }
+    }
+
+    if (!changedListings.empty()) {
+        // Cached outcomes were resolved against the old listings
+        referenceCache_.clear();
+        for (const auto& directory : changedListings) {
+            for (auto& page : reverseIndex_->dependents(directory)) {
+                queue(std::move(page));
+            }
+        }
+    }
+
+    correctPages(pages);
+    if (report_) {
+        report_->flush();
+    }
+    writer_->flush();
+}
+
+void HtmlCaseCorrector::correctPages(const std::vector<fs::path>& pages) {
+    // These pages are known to need a look. The manifest isn't asked: the
+    // directory mtimes it compares against date from the first pass.
+    auto correct = [this](const fs::path& page) {
         try {
-            processFile(htmlFile);
+            std::error_code ec;
+            if (!fs::is_regular_file(page, ec)) {
+                return;  // removed again since the event
+            }
+            if (streams(page)) {
+                processLargeFile(page);
+                return;
+            }
+            MappedFile content = mapPage(page);
+            processContent(page, content.view());
         } catch (const std::exception& e) {
-            std::cerr << "Error processing " << htmlFile << ": " << e.what() << std::endl;
+            reportError(page, e);
         }
+    };
+
+    if (jobs_ <= 1 || pages.size() <= 1) {
+        for (const auto& page : pages) {
+            correct(page);
+        }
+        return;
     }
+    std::unique_ptr<WorkStealingPool> ownPool = watchPool_ ? nullptr : makePool(jobs_);
+    WorkStealingPool& pool = watchPool_ ? *watchPool_ : *ownPool;
+    for (const auto& page : pages) {
+        pool.submit([&correct, &page] { correct(page); });
+    }
+    pool.wait();
 }
 
-std::optional<fs::path> HtmlCaseCorrector::getActualPath(const fs::path& path) const {
-    if (!fs::exists(path.parent_path())) {
-        return std::nullopt;
+unsigned HtmlCaseCorrector::listingJobs() const {
+    return std::max(1u, jobs_ / kJobsPerListingThread);
+}
+
+unsigned HtmlCaseCorrector::processingJobs() const {
+    const unsigned listing = listingJobs();
+    return listing > 1 ? jobs_ - listing : jobs_;
+}
+
+std::unique_ptr<WorkStealingPool> HtmlCaseCorrector::makePool(unsigned threads) const {
+    if (jobs_ <= 1) {
+        return nullptr;
     }
+    size_t perJob = ioEngine_ == IoEngine::Uring ? kQueuedBuffersPerJob : kQueuedFilesPerJob;
+    return std::make_unique<WorkStealingPool>(threads, static_cast<size_t>(threads) * perJob);
+}
 
-    try {
-        for (const auto& entry : fs::directory_iterator(path.parent_path())) {
-            if (comparePathsIgnoreCase(entry.path().filename(), path.filename())) {
-                return entry.path();
+void HtmlCaseCorrector::runFiles(const fs::path& startDir) {
+    // Traversal feeds a bounded pool so discovery, reading, parsing and
+    // writing overlap while only a fixed number of files are held in memory.
+    // While watching, the first pass runs on the pool every batch reuses
+    std::unique_ptr<WorkStealingPool> ownPool = watchPool_ ? nullptr : makePool(processingJobs());
+    WorkStealingPool* pool = watchPool_ ? watchPool_.get() : ownPool.get();
+
+    auto dispatch = [this, pool](const fs::path& htmlFile, std::function<void(const fs::path&)> work) {
+        auto task = [this, htmlFile, work = std::move(work)] {
+            try {
+                work(htmlFile);
+            } catch (const std::exception& e) {
+                reportError(htmlFile, e);
+            }
+        };
+        if (pool) {
+            pool->submit(std::move(task));
+        } else {
+            task();
+        }
+    };
+
+    std::unique_ptr<AsyncReader> reader;
+    if (ioEngine_ == IoEngine::Uring) {
+        reader = AsyncReader::create(AsyncReader::kDefaultDepth,
+            [this, &dispatch](const fs::path& htmlFile, std::string content) {
+                auto buffer = std::make_shared<const std::string>(std::move(content));
+                dispatch(htmlFile, [this, buffer](const fs::path& file) {
+                    processContent(file, *buffer);
+                });
+            },
+            [this](const fs::path& htmlFile, const std::exception& e) {
+                reportError(htmlFile, e);
+            });
+        // Without io_uring the reader is null and every file takes the sync path
+    }
+
+    // The walker's threads and the pool's together make up jobs_
+    walkHtmlFiles(startDir, [&](const fs::path& htmlFile) {
+        // A streamed page is never read whole, so it takes the sync path
+        if (!reader || streams(htmlFile)) {
+            dispatch(htmlFile, [this](const fs::path& file) {
+                processFile(file);
+            });
+            return;
+        }
+
+        // Pages the manifest settles from their stamp never queue a read
+        try {
+            if (tracksManifest() && isUpToDate(htmlFile)) {
+                unchangedFiles_.fetch_add(1, std::memory_order_relaxed);
+                count(RunStats::Counter::FilesUnchanged);
+                return;
             }
+        } catch (const std::exception& e) {
+            reportError(htmlFile, e);
+            return;
         }
-    } catch (const fs::filesystem_error&) {
-        return std::nullopt;
+        reader->read(htmlFile);
+    }, pool ? listingJobs() : 1);
+
+    if (reader) {
+        reader->drain();
     }
+    if (pool) {
+        pool->wait();
+    }
+}
+
+void HtmlCaseCorrector::setJobs(unsigned jobs) {
+    jobs_ = jobs != 0 ? jobs : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void HtmlCaseCorrector::setEngine(ParseEngine engine) {
+    engine_ = engine;
+}
+
+void HtmlCaseCorrector::setShard(unsigned index, unsigned count) {
+    if (count == 0 || index >= count) {
+        throw std::runtime_error("Shard " + std::to_string(index) + "/" + std::to_string(count) +
+                                 " is out of range");
+    }
+    shardIndex_ = index;
+    shardCount_ = count;
+}
+
+unsigned HtmlCaseCorrector::shardOf(std::string_view topLevelName, unsigned count) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : topLevelName) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return static_cast<unsigned>(hash % count);
+}
+
+bool HtmlCaseCorrector::inShard(const fs::path& page) const {
+    if (shardCount_ == 1) {
+        return true;
+    }
+    // "site/" and "site" are the same root
+    const fs::path root = runRoot_.has_filename() ? runRoot_ : runRoot_.parent_path();
+    const fs::path relative = page.lexically_relative(root);
+    auto first = relative.begin();
+    std::string topLevel;
+    if (first != relative.end() && std::next(first) != relative.end()) {
+        topLevel = first->string();
+    }
+    return shardOf(topLevel, shardCount_) == shardIndex_;
+}
+
+DirectoryWatcher::TopLevelFilter HtmlCaseCorrector::shardFilter() const {
+    if (shardCount_ == 1) {
+        return {};
+    }
+    return [this](std::string_view name, bool isDirectory) {
+        return shardOf(isDirectory ? name : std::string_view(), shardCount_) == shardIndex_;
+    };
+}
+
+size_t HtmlCaseCorrector::skippedFiles() const {
+    return skippedFiles_.load(std::memory_order_relaxed);
+}
+
+void HtmlCaseCorrector::setManifest(const fs::path& path) {
+    manifestPath_ = path;
+    manifest_ = path.empty() ? nullptr : std::make_unique<Manifest>();
+    directoryIndex_.setRecordMtimes(manifest_ || !snapshotPath_.empty());
+}
+
+size_t HtmlCaseCorrector::unchangedFiles() const {
+    return unchangedFiles_.load(std::memory_order_relaxed);
+}
+
+void HtmlCaseCorrector::setIndexSnapshot(const fs::path& path) {
+    snapshotPath_ = path;
+    directoryIndex_.setRecordMtimes(manifest_ || !snapshotPath_.empty());
+}
+
+void HtmlCaseCorrector::setStreamingThreshold(uint64_t bytes) {
+    streamingThreshold_ = bytes;
+}
+
+void HtmlCaseCorrector::setDryRun(bool dryRun) {
+    dryRun_ = dryRun;
+}
+
+void HtmlCaseCorrector::setReport(const fs::path& path) {
+    report_ = path.empty() ? nullptr : std::make_unique<RewriteReport>(path);
+}
+
+void HtmlCaseCorrector::setSyncPolicy(SyncPolicy policy) {
+    writer_ = std::make_unique<AtomicWriter>(policy);
+}
+
+void HtmlCaseCorrector::setIoEngine(IoEngine engine) {
+    ioEngine_ = engine;
+}
+
+bool HtmlCaseCorrector::tracksManifest() const {
+    // A dry run leaves pages unfixed, so it must not mark them up to date
+    return manifest_ && !dryRun_;
+}
+
+void HtmlCaseCorrector::saveManifest() {
+    manifest_->save(manifestPath_, [this](const std::string& directory) -> std::optional<int64_t> {
+        const std::optional<int64_t> mtime = directoryIndex_.listedMtime(directory);
+        if (mtime && *mtime == DirectoryIndex::kNoMtime) {
+            return -1;
+        }
+        return mtime;
+    });
+}
+
+std::optional<fs::path> HtmlCaseCorrector::getActualPath(const fs::path& path) const {
+    RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Resolve);
+    return directoryIndex_.resolve(path);
+}
+
+void HtmlCaseCorrector::setStats(bool enabled) {
+    stats_ = enabled ? std::make_unique<RunStats>() : nullptr;
+}
+
+void HtmlCaseCorrector::count(RunStats::Counter counter, uint64_t amount) const {
+    if (stats_) {
+        stats_->add(counter, amount);
+    }
+}
+
+void HtmlCaseCorrector::recordWallTime(std::chrono::steady_clock::time_point started) const {
+    if (stats_) {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        stats_->setWallTime(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+}
 
-    return std::nullopt;
+MappedFile HtmlCaseCorrector::mapPage(const fs::path& htmlFile) const {
+    RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Read);
+    return MappedFile(htmlFile, readPages_ ? MappedFile::Mode::Read : MappedFile::Mode::Map);
 }
 
 void HtmlCaseCorrector::processFile(const fs::path& htmlFile) {
-    std::string content = readFile(htmlFile);
-    std::string corrected = correctFileReferences(content, htmlFile);
-    
-    if (content != corrected) {
-        writeFile(htmlFile, corrected);
+    if (tracksManifest() && isUpToDate(htmlFile)) {
+        unchangedFiles_.fetch_add(1, std::memory_order_relaxed);
+        count(RunStats::Counter::FilesUnchanged);
+        return;
     }
+
+    if (streams(htmlFile)) {
+        processLargeFile(htmlFile);
+        return;
+    }
+
+    // Gumbo parses straight out of the mapping. It may stay mapped while the
+    // page is rewritten: the writer replaces the file rather than truncating
+    // it. Other programs may not, which is why watch() has pages read instead.
+    MappedFile content = mapPage(htmlFile);
+    processContent(htmlFile, content.view());
 }
 
-std::vector<fs::path> HtmlCaseCorrector::findHtmlFiles(const fs::path& directory) const {
-    std::vector<fs::path> htmlFiles;
-    const std::unordered_set<std::string> validExtensions = {".html", ".htm"};
+void HtmlCaseCorrector::processContent(const fs::path& htmlFile, std::string_view content) {
+    if (!tracksDependencies()) {
+        correctContent(htmlFile, content, nullptr);
+        return;
+    }
 
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-            if (entry.is_regular_file()) {
-                std::string ext = entry.path().extension().string();
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                if (validExtensions.count(ext) > 0) {
-                    htmlFiles.push_back(entry.path());
-                }
+    std::vector<fs::path> dependencies;
+    const bool rewritten = correctContent(htmlFile, content, &dependencies);
+
+    // A page left alone is still what was just read, so the manifest hashes
+    // it from memory rather than opening it again
+    std::optional<uint64_t> hash;
+    if (!rewritten && tracksManifest()) {
+        hash = Manifest::hashContent(content);
+    }
+    recordDependencies(htmlFile, dependencies, hash);
+}
+
+bool HtmlCaseCorrector::correctContent(const fs::path& htmlFile, std::string_view content,
+                                       std::vector<fs::path>* dependencies) {
+    count(RunStats::Counter::FilesScanned);
+    count(RunStats::Counter::BytesRead, content.size());
+    if (!mayContainLocalReference(content)) {
+        skippedFiles_.fetch_add(1, std::memory_order_relaxed);
+        count(RunStats::Counter::FilesSkipped);
+        return false;
+    }
+
+    // The document is only copied when there is something to rewrite
+    Document document{content, htmlFile, directoryIndex_, &referenceCache_, {}, dependencies};
+    collectEdits(document);
+    if (document.edits.empty()) {
+        return false;
+    }
+    if (report_) {
+        normalizeEdits(content, document.edits);
+        report_->record(htmlFile, content, document.edits);
+    }
+    if (dryRun_) {
+        return false;
+    }
+
+    std::string corrected;
+    {
+        RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Splice);
+        corrected = applyEdits(content, document.edits);
+    }
+    writeFile(htmlFile, corrected);
+    count(RunStats::Counter::FilesRewritten);
+    count(RunStats::Counter::BytesWritten, corrected.size());
+    return true;
+}
+
+bool HtmlCaseCorrector::streams(const fs::path& htmlFile) const {
+    if (streamingThreshold_ == 0) {
+        return false;
+    }
+    std::error_code ec;
+    const uintmax_t size = fs::file_size(htmlFile, ec);
+    return !ec && size >= streamingThreshold_;
+}
+
+void HtmlCaseCorrector::processLargeFile(const fs::path& htmlFile) {
+    if (!tracksDependencies()) {
+        correctStreaming(htmlFile, nullptr, nullptr);
+        return;
+    }
+
+    std::vector<fs::path> dependencies;
+    uint64_t hash = Manifest::kHashSeed;
+    const bool rewritten = correctStreaming(htmlFile, &dependencies, tracksManifest() ? &hash : nullptr);
+    recordDependencies(htmlFile, dependencies,
+                       rewritten || !tracksManifest() ? std::nullopt : std::optional<uint64_t>(hash));
+}
+
+bool HtmlCaseCorrector::correctStreaming(const fs::path& htmlFile, std::vector<fs::path>* dependencies,
+                                         uint64_t* hash) {
+    count(RunStats::Counter::FilesScanned);
+    std::ifstream in(htmlFile, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open file: " + htmlFile.string());
+    }
+
+    Document document{std::string_view(), htmlFile, directoryIndex_, &referenceCache_, {}, dependencies};
+    locateDocument(document);
+
+    // Nothing is written before the first edit: most pages need none, and
+    // those stay untouched. Memory holds one window, its spans and edits.
+    std::unique_ptr<AtomicWriter::Replacement> out;
+    thread_local std::vector<AttributeSpan> spans;
+    std::string window;
+    size_t windowSize = kStreamWindowBytes;
+    uint64_t base = 0;  // offset of the window in the page
+    ScanState state;
+    bool final = false;
+    for (;;) {
+        if (!final && window.size() < windowSize) {
+            RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Read);
+            const size_t have = window.size();
+            window.resize(windowSize);
+            in.read(window.data() + have, static_cast<std::streamsize>(windowSize - have));
+            if (in.bad()) {
+                throw std::runtime_error("Cannot read file: " + htmlFile.string());
             }
+            window.resize(have + static_cast<size_t>(in.gcount()));
+            final = in.eof();
+            if (hash) {
+                *hash = Manifest::hashContent(std::string_view(window).substr(have), *hash);
+            }
+            count(RunStats::Counter::BytesRead, static_cast<uint64_t>(in.gcount()));
+        }
+
+        spans.clear();
+        size_t consumed;
+        {
+            RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Parse);
+            consumed = scanAttributeWindow(window, final, state, [](const AttributeSpan& attr) {
+                spans.push_back(attr);
+            });
         }
+        if (consumed == 0 && !final) {
+            if (windowSize >= kMaxStreamWindowBytes) {
+                // Whatever was already written is discarded with `out`
+                throw std::runtime_error("Markup too long to stream at offset " + std::to_string(base) +
+                                         "; page left unchanged");
+            }
+            windowSize *= 2;
+            continue;
+        }
+
+        document.content = std::string_view(window).substr(0, consumed);
+        document.edits.clear();
+        for (const AttributeSpan& attr : spans) {
+            updateValue(attr.kind, attr.valueOffset, attr.valueLength, document);
+        }
+        if (!document.edits.empty()) {
+            normalizeEdits(document.content, document.edits);
+            if (report_) {
+                report_->record(htmlFile, document.content, document.edits, base);
+            }
+            if (!out && !dryRun_) {
+                RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Write);
+                out = writer_->begin(htmlFile);
+                copyFront(htmlFile, base, *out);
+            }
+        }
+        if (out) {
+            RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Write);
+            size_t pos = 0;
+            for (const auto& edit : document.edits) {
+                out->append(document.content.substr(pos, edit.offset - pos));
+                out->append(edit.replacement);
+                pos = edit.offset + edit.length;
+            }
+            out->append(document.content.substr(pos));
+        }
+        if (dependencies) {
+            // Every reference adds its listings; keep one of each
+            std::sort(dependencies->begin(), dependencies->end());
+            dependencies->erase(std::unique(dependencies->begin(), dependencies->end()), dependencies->end());
+        }
+
+        window.erase(0, consumed);
+        base += consumed;
+        if (final) {
+            break;
+        }
+    }
+
+    if (!out) {
+        return false;
+    }
+    {
+        RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Write);
+        out->commit();
+    }
+    count(RunStats::Counter::FilesRewritten);
+    count(RunStats::Counter::BytesWritten, out->size());
+    return true;
+}
+
+bool HtmlCaseCorrector::tracksDependencies() const {
+    return tracksManifest() || reverseIndex_;
+}
+
+bool HtmlCaseCorrector::isUpToDate(const fs::path& htmlFile) {
+    const Manifest::FileEntry* previous = manifest_->previous(htmlFile);
+    if (!previous || !manifest_->dependenciesUnchanged(*previous)) {
+        return false;
+    }
+
+    Manifest::FileEntry entry = *previous;
+    Manifest::stamp(htmlFile, entry.size, entry.mtime);
+    if (entry.size != previous->size) {
+        return false;
+    }
+    if (entry.mtime != previous->mtime) {
+        // Touched but possibly not edited: the content hash decides
+        MappedFile content = mapPage(htmlFile);
+        if (Manifest::hashContent(content.view()) != previous->hash) {
+            return false;
+        }
+    }
+
+    if (reverseIndex_) {
+        reverseIndex_->record(htmlFile, entry.dependencies);
+    }
+    manifest_->record(htmlFile, std::move(entry));
+    return true;
+}
+
+void HtmlCaseCorrector::recordDependencies(const fs::path& htmlFile, const std::vector<fs::path>& dependencies,
+                                           std::optional<uint64_t> hash) {
+    // Directories above the run root are outside the tree being tracked;
+    // their mtimes change for unrelated reasons
+    std::vector<std::string> directories;
+    for (const auto& directory : dependencies) {
+        if (!runRoot_.empty() && isStrictAncestor(directory, runRoot_)) {
+            continue;
+        }
+        directories.push_back(directory.string());
+    }
+    std::sort(directories.begin(), directories.end());
+    directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+
+    if (reverseIndex_) {
+        reverseIndex_->record(htmlFile, directories);
+    }
+    if (!tracksManifest()) {
+        return;
+    }
+
+    Manifest::FileEntry entry;
+    Manifest::stamp(htmlFile, entry.size, entry.mtime);
+    if (hash) {
+        entry.hash = *hash;
+    } else {
+        MappedFile content = mapPage(htmlFile);
+        entry.hash = Manifest::hashContent(content.view());
+    }
+    entry.dependencies = std::move(directories);
+    manifest_->record(htmlFile, std::move(entry));
+}
+
+bool HtmlCaseCorrector::isStrictAncestor(const fs::path& ancestor, const fs::path& path) {
+    auto mismatch = std::mismatch(ancestor.begin(), ancestor.end(), path.begin(), path.end());
+    return mismatch.first == ancestor.end() && mismatch.second != path.end();
+}
+
+void HtmlCaseCorrector::forEachHtmlFile(const fs::path& directory,
+                                        const std::function<void(const fs::path&)>& visit) const {
+    walkHtmlFiles(directory, visit, jobs_);
+}
+
+void HtmlCaseCorrector::walkHtmlFiles(const fs::path& directory, const std::function<void(const fs::path&)>& visit,
+                                      unsigned threads) const {
+    // Discovery lists every directory of the tree anyway, so its listings
+    // seed the index that reference resolution reads from
+    try {
+        DirectoryWalker walker(threads, &directoryIndex_);
+        walker.setTopLevelFilter(shardFilter());
+        walker.walk(directory, &HtmlCaseCorrector::isHtmlName, visit);
     } catch (const fs::filesystem_error& e) {
         std::cerr << "Error accessing directory: " << e.what() << std::endl;
     }
+}
 
+bool HtmlCaseCorrector::isHtmlName(std::string_view name) {
+    const std::string ext = foldCase(fs::path(name).extension().string());
+    return ext == ".html" || ext == ".htm";
+}
+
+std::vector<fs::path> HtmlCaseCorrector::findHtmlFiles(const fs::path& directory) const {
+    std::vector<fs::path> htmlFiles;
+    forEachHtmlFile(directory, [&htmlFiles](const fs::path& htmlFile) {
+        htmlFiles.push_back(htmlFile);
+    });
     return htmlFiles;
 }
 
-std::string HtmlCaseCorrector::correctFileReferences(const std::string& content, const fs::path& htmlFile) {
-    GumboOutput* output = gumbo_parse(content.c_str());
-    std::string result = content;
+std::vector<TextEdit> HtmlCaseCorrector::planEdits(std::string_view content, const fs::path& htmlFile,
+                                                   DirectoryIndex& index) {
+    if (!mayContainLocalReference(content)) {
+        return {};
+    }
+    Document document{content, htmlFile, index, nullptr, {}, nullptr};
+    document.onDisk = false;
+    collectEdits(document);
+    normalizeEdits(content, document.edits);
+    return std::move(document.edits);
+}
 
-    if (output) {
-        processNode(output->root, htmlFile, result);
-        gumbo_destroy_output(&kGumboDefaultOptions, output);
+std::string HtmlCaseCorrector::correctDocument(std::string_view content, const fs::path& htmlFile,
+                                               DirectoryIndex& index) {
+    std::string corrected;
+    if (correctDocument(content, htmlFile, index, corrected) == 0) {
+        return std::string(content);
     }
+    return corrected;
+}
 
-    return result;
+size_t HtmlCaseCorrector::correctDocument(std::string_view content, const fs::path& htmlFile,
+                                          DirectoryIndex& index, std::string& corrected) {
+    std::vector<TextEdit> edits = planEdits(content, htmlFile, index);
+    if (!edits.empty()) {
+        corrected = applyEdits(content, edits);
+    }
+    return edits.size();
 }
 
-void HtmlCaseCorrector::processNode(GumboNode* node, const fs::path& htmlFile, std::string& content) {
-    if (node->type != GUMBO_NODE_ELEMENT) {
-        return;
+std::string HtmlCaseCorrector::correctFileReferences(std::string_view content, const fs::path& htmlFile) {
+    std::string corrected;
+    if (correctFileReferences(content, htmlFile, corrected) == 0) {
+        return std::string(content);
     }
+    return corrected;
+}
 
-    GumboAttribute* src = gumbo_get_attribute(&node->v.element.attributes, "src");
-    GumboAttribute* href = gumbo_get_attribute(&node->v.element.attributes, "href");
+size_t HtmlCaseCorrector::correctFileReferences(std::string_view content, const fs::path& htmlFile,
+                                                std::string& corrected) {
+    Document document{content, htmlFile, directoryIndex_, &referenceCache_, {}, nullptr};
+    collectEdits(document);
+    if (!document.edits.empty()) {
+        corrected = applyEdits(content, document.edits);
+    }
+    return document.edits.size();
+}
 
-    if (src) {
-        updateAttribute(src, htmlFile, content);
+void HtmlCaseCorrector::locateDocument(Document& document) {
+    // References are joined onto the page's directory as interned IDs, so
+    // resolving one and relativizing it back allocate no intermediate paths
+    PathTable& paths = document.index.paths();
+    const PathTable::Id directory = paths.intern(document.htmlFile.parent_path());
+    if (document.onDisk) {
+        // The page was read from this very path, so only what its references
+        // add below it is case-folded
+        document.index.trust(directory);
+        document.directory = directory;
+        return;
     }
-    if (href) {
-        updateAttribute(href, htmlFile, content);
+
+    PathTable::Id actualDirectory;
+    {
+        RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Resolve);
+        actualDirectory = document.index.resolve(directory);
+    }
+    document.directory = actualDirectory != PathTable::kNone ? actualDirectory : directory;
+}
+
+void HtmlCaseCorrector::collectEdits(Document& document) {
+    const std::string_view content = document.content;
+    locateDocument(document);
+
+    if (engine_ == ParseEngine::Lexer) {
+        // Spans are resolved after the scan, so that the parse and resolve
+        // timers each measure only their own stage
+        thread_local std::vector<AttributeSpan> spans;
+        spans.clear();
+        bool scanned;
+        {
+            RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Parse);
+            scanned = scanAttributes(content, [](const AttributeSpan& attr) {
+                spans.push_back(attr);
+            });
+        }
+        if (scanned) {
+            for (const AttributeSpan& attr : spans) {
+                updateValue(attr.kind, attr.valueOffset, attr.valueLength, document);
+            }
+            return;
+        }
+        // Markup the lexer can't vouch for goes through the full parser
     }
 
-    GumboVector* children = &node->v.element.children;
-    for (unsigned int i = 0; i < children->length; ++i) {
-        processNode(static_cast<GumboNode*>(children->data[i]), htmlFile, content);
+    // Each worker thread parses into its own arena. The tree is never
+    // destroyed node by node: resetting the arena frees the whole parse.
+    thread_local BumpArena arena;
+    struct ArenaReset {
+        BumpArena& arena;
+        ~ArenaReset() { arena.reset(); }
+    } resetOnExit{arena};
+
+    GumboOptions options = kGumboDefaultOptions;
+    options.allocator = &BumpArena::gumboAllocate;
+    options.deallocator = &BumpArena::gumboDeallocate;
+    options.userdata = &arena;
+
+    GumboOutput* output;
+    {
+        RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Parse);
+        output = gumbo_parse_with_options(&options, content.data(), content.size());
+    }
+    if (output) {
+        processNode(output->root, document);
     }
 }
 
-void HtmlCaseCorrector::updateAttribute(GumboAttribute* attr, const fs::path& htmlFile, std::string& content) {
-    fs::path refPath = fs::path(attr->value);
-    fs::path fullPath = htmlFile.parent_path() / refPath;
+void HtmlCaseCorrector::processNode(GumboNode* node, Document& document) {
+    // Explicit stack instead of recursion: generated pages nest deep enough
+    // to overflow the call stack
+    std::vector<GumboNode*> pending{node};
+    while (!pending.empty()) {
+        GumboNode* current = pending.back();
+        pending.pop_back();
+        if (current->type != GUMBO_NODE_ELEMENT && current->type != GUMBO_NODE_TEMPLATE) {
+            continue;
+        }
+
+        // One pass over the attributes checks every reference attribute
+        const GumboElement& element = current->v.element;
+        const GumboVector& attributes = element.attributes;
+        for (unsigned int i = 0; i < attributes.length; ++i) {
+            auto* attr = static_cast<GumboAttribute*>(attributes.data[i]);
+            ReferenceKind kind = referenceKind(element.tag, attr->name);
+            if (kind != ReferenceKind::None) {
+                updateAttribute(attr, kind, document);
+            }
+        }
+
+        const GumboVector& children = element.children;
+        if (element.tag == GUMBO_TAG_STYLE) {
+            for (unsigned int i = 0; i < children.length; ++i) {
+                updateStyleSheet(static_cast<GumboNode*>(children.data[i]), document);
+            }
+        }
 
-    auto actualPath = getActualPath(fullPath);
-    if (actualPath) {
-        fs::path relativePath = fs::relative(*actualPath, htmlFile.parent_path());
-        replaceInContent(content, attr->value, relativePath.string());
+        // Push children in reverse so they are visited in document order
+        for (unsigned int i = children.length; i > 0; --i) {
+            pending.push_back(static_cast<GumboNode*>(children.data[i - 1]));
+        }
     }
 }
 
-bool HtmlCaseCorrector::comparePathsIgnoreCase(const fs::path& a, const fs::path& b) const {
-    std::string aStr = a.string();
-    std::string bStr = b.string();
-    return std::equal(aStr.begin(), aStr.end(), bStr.begin(), bStr.end(),
-                     [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+void HtmlCaseCorrector::updateAttribute(GumboAttribute* attr, ReferenceKind kind, Document& document) {
+    const std::string_view content = document.content;
+
+    // Locate the value in the source; original_value still has its quotes
+    const char* raw = attr->original_value.data;
+    size_t rawLength = attr->original_value.length;
+    if (!raw || raw < content.data() || raw + rawLength > content.data() + content.size()) {
+        return;
+    }
+    if (rawLength >= 2 && (raw[0] == '"' || raw[0] == '\'') && raw[rawLength - 1] == raw[0]) {
+        ++raw;
+        rawLength -= 2;
+    }
+
+    // Values written with character references can't be spliced byte for byte
+    std::string_view source(raw, rawLength);
+    if (source != attr->value) {
+        return;
+    }
+
+    updateValue(kind, static_cast<size_t>(raw - content.data()), rawLength, document);
 }
 
-void HtmlCaseCorrector::replaceInContent(std::string& content, const std::string& oldStr, const std::string& newStr) {
-    size_t pos = 0;
-    while ((pos = content.find(oldStr, pos)) != std::string::npos) {
-        content.replace(pos, oldStr.length(), newStr);
-        pos += newStr.length();
+void HtmlCaseCorrector::updateStyleSheet(GumboNode* node, Document& document) {
+    // Raw text isn't decoded, so the original text is the style sheet itself
+    const std::string_view content = document.content;
+    if (node->type != GUMBO_NODE_TEXT) {
+        return;
     }
+    const char* raw = node->v.text.original_text.data;
+    size_t rawLength = node->v.text.original_text.length;
+    if (!raw || raw < content.data() || raw + rawLength > content.data() + content.size()) {
+        return;
+    }
+    updateValue(ReferenceKind::Css, static_cast<size_t>(raw - content.data()), rawLength, document);
 }
 
-std::string HtmlCaseCorrector::readFile(const fs::path& path) const {
-    std::ifstream file(path, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Cannot open file: " + path.string());
+void HtmlCaseCorrector::updateValue(ReferenceKind kind, size_t offset, size_t length, Document& document) {
+    const std::string_view value = document.content.substr(offset, length);
+    forEachUrl(kind, value, [&](size_t urlOffset, size_t urlLength) {
+        updateReference(value.substr(urlOffset, urlLength), offset + urlOffset, document);
+    });
+}
+
+void HtmlCaseCorrector::updateReference(std::string_view value, size_t offset, Document& document) {
+    // A query or fragment isn't part of the file name and is never touched
+    // and a URL off the site isn't resolved (or depended on) at all
+    const std::string_view path = value.substr(0, value.find_first_of("?#"));
+    if (path.empty() || isNonLocalUrl(value)) {
+        return;
+    }
+
+    ReferenceCache::Outcome outcome;
+    if (document.cache && document.cache->find(document.directory, path, outcome)) {
+        count(RunStats::Counter::CacheHits);
+    } else {
+        RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Resolve);
+        PathTable& paths = document.index.paths();
+        outcome.target = paths.intern(document.directory, path);
+        const PathTable::Id actual = document.index.resolve(outcome.target);
+        outcome.resolved = actual != PathTable::kNone;
+
+        // Resolution keeps the shape of the path, so the fix is the reference
+        // as the author wrote it with each name respelled; nothing is relativized
+        if (outcome.resolved) {
+            std::string corrected = paths.respell(path, actual);
+            if (corrected != path) {
+                outcome.replacement = std::move(corrected);
+            }
+        }
+        if (document.cache) {
+            document.cache->insert(document.directory, path, outcome);
+        }
+    }
+
+    if (document.dependencies) {
+        document.index.dependencies(outcome.target, *document.dependencies);
+    }
+    count(outcome.resolved ? RunStats::Counter::ReferencesResolved : RunStats::Counter::ReferencesUnresolved);
+    if (!outcome.replacement.empty()) {
+        count(RunStats::Counter::ReferencesCorrected);
+        document.edits.push_back({offset, path.size(), std::move(outcome.replacement)});
     }
-    return std::string(std::istreambuf_iterator<char>(file),
-                      std::istreambuf_iterator<char>());
 }
 
-void HtmlCaseCorrector::writeFile(const fs::path& path, const std::string& content) const {
-    std::ofstream file(path, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Cannot write file: " + path.string());
+bool HtmlCaseCorrector::comparePathsIgnoreCase(const fs::path& a, const fs::path& b) const {
+    // POSIX paths are already narrow strings and are compared in place
+    if constexpr (std::is_same_v<fs::path::value_type, char>) {
+        return equalsIgnoreCase(a.native(), b.native());
+    } else {
+        return equalsIgnoreCase(a.string(), b.string());
     }
-    file << content;
 }
 
+std::string HtmlCaseCorrector::readFile(const fs::path& path) const {
+    MappedFile file = mapPage(path);
+    return std::string(file.view());
+}
 
+void HtmlCaseCorrector::writeFile(const fs::path& path, const std::string& content) const {
+    RunStats::ScopedTimer timer(stats_.get(), RunStats::Timer::Write);
+    writer_->write(path, content);
+}
 
-#endif // HTML_CASE_CORRECTOR_H
+void HtmlCaseCorrector::reportError(const fs::path& htmlFile, const std::exception& e) const {
+    // Format the whole line first so concurrent workers never interleave
+    std::ostringstream message;
+    message << "Error processing " << htmlFile << ": " << e.what() << '\n';
+
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    std::cerr << message.str() << std::flush;
+}
@@ -3,6 +3,7 @@
 #define HTML_CASE_CORRECTOR_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <optional>
@@ -12,38 +13,317 @@
 #include <locale>
 #include <algorithm>
 #include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include "gumbo.h" // HTML parser library
+#include "AtomicWriter.h"
+#include "DirectoryIndex.h"
+#include "DirectoryWatcher.h"
+#include "ReferenceCache.h"
+#include "ReferenceRules.h"
+#include "RunStats.h"
+#include "SpliceRewriter.h"
+
+class Manifest;
+class MappedFile;
+class ReverseIndex;
+class RewriteReport;
+class WorkStealingPool;
 
 namespace fs = std::filesystem;
 
+// How documents are searched for references
+enum class ParseEngine {
+    Gumbo,  // full HTML5 parse into a DOM
+    Lexer   // streaming tag scan, falling back to Gumbo on malformed input
+};
+
+// How page contents are read
+enum class IoEngine {
+    Sync,   // mmap each page on the worker that processes it
+    Uring   // keep many reads in flight on io_uring; Sync where unavailable
+};
+
 class HtmlCaseCorrector {
 public:
+    HtmlCaseCorrector();
+    ~HtmlCaseCorrector();
+
     // Main function to process a directory
     void processDirectory(const fs::path& startDir);
 
+    // Correct `startDir` once, then keep correcting it from inotify events
+    // until stopWatching() is called: pages that were written or moved in,
+    // and pages whose references resolve through a listing that changed.
+    // The directory index stays in memory between batches. Throws
+    // std::runtime_error where inotify isn't available.
+    void watch(const fs::path& startDir);
+
+    // End watch() after its current batch; safe from any thread. If called
+    // before watch() starts, the next watch() returns right away.
+    void stopWatching();
+
+    // Correct only the pages that may be affected by changes to `changed`
+    // (assets or directories added, removed or renamed), going by the
+    // dependencies recorded in the manifest of an earlier run; see
+    // affectedPages(). Needs setManifest(). Pages added since that run are
+    // unknown to the manifest and left alone.
+    void processAffected(const fs::path& startDir, const std::vector<fs::path>& changed);
+
+    // The pages processAffected() would correct, from the manifest on disk
+    std::vector<fs::path> affectedPages(const std::vector<fs::path>& changed) const;
+
+    // Plan the fixes for a page held in memory, as if it were stored at
+    // `htmlFile`. References resolve against `index` alone, so with an index
+    // that doesn't read from disk nothing touches the filesystem. Edits come
+    // back sorted and non-overlapping; `index` may be shared between threads.
+    std::vector<TextEdit> planEdits(std::string_view content, const fs::path& htmlFile, DirectoryIndex& index);
+
+    // The page with those edits applied
+    std::string correctDocument(std::string_view content, const fs::path& htmlFile, DirectoryIndex& index);
+
+    // Same, but returns the number of edits and only assigns `corrected`
+    // when there are some, so a clean page costs no copy
+    size_t correctDocument(std::string_view content, const fs::path& htmlFile, DirectoryIndex& index,
+                           std::string& corrected);
+
+    // Number of worker threads used by processDirectory (0 = one per core).
+    // While pages are processed, directory listing takes a share of them.
+    void setJobs(unsigned jobs);
+
+    // Select the engine used to find references (default: Gumbo)
+    void setEngine(ParseEngine engine);
+
+    // Only process shard `index` of `count` (default: 0 of 1, everything).
+    // Each top-level subdirectory of the run, and the files directly in
+    // its root, belong to one shard as shardOf() decides; the walk never
+    // enters the others, so no two shards list the same subtree.
+    void setShard(unsigned index, unsigned count);
+
+    // Stable across runs and machines: FNV-1a of the name's bytes, mod `count`
+    static unsigned shardOf(std::string_view topLevelName, unsigned count);
+
+    // Files the prefilter ruled out before parsing, since construction
+    size_t skippedFiles() const;
+
+    // Keep an incremental-run manifest at `path` (empty disables). processDirectory
+    // then skips pages that neither changed nor depend on a changed directory.
+    void setManifest(const fs::path& path);
+
+    // Files the manifest showed to be up to date, since construction
+    size_t unchangedFiles() const;
+
+    // Keep a snapshot of the directory index at `path` (empty disables).
+    // Runs start from it, so a directory whose mtime hasn't changed is
+    // neither listed during discovery nor read for lookups, and save it
+    // when they finish.
+    void setIndexSnapshot(const fs::path& path);
+
+    // Memo of resolved references for the current run, with its counters
+    const ReferenceCache& referenceCache() const { return referenceCache_; }
+
+    // Pages of at least `bytes` are corrected in bounded memory: read and
+    // scanned a window at a time, and written out as they go (0 disables).
+    // Streamed pages always go through the lexer; no full parse fits in a
+    // window, so whatever the lexer would have left to Gumbo stays as it is.
+    void setStreamingThreshold(uint64_t bytes);
+
+    static constexpr uint64_t kDefaultStreamingThreshold = uint64_t(64) << 20;
+
+    // A streamed page is read this much at a time. A window only grows, up
+    // to the maximum, to fit a tag or style sheet larger than itself; a
+    // page with a longer one is left unchanged.
+    static constexpr size_t kStreamWindowBytes = size_t(1) << 20;
+    static constexpr size_t kMaxStreamWindowBytes = size_t(16) << 20;
+
+    // Plan rewrites without writing any file
+    void setDryRun(bool dryRun);
+
+    // Log every rewrite (planned or applied) as JSON Lines to `path`, "-" for
+    // stdout, empty to disable
+    void setReport(const fs::path& path);
+
+    // Durability of rewritten pages; every rewrite is an atomic replace,
+    // which gives a hard-linked page a file of its own (see AtomicWriter)
+    void setSyncPolicy(SyncPolicy policy);
+
+    // Select how page contents are read (default: Sync)
+    void setIoEngine(IoEngine engine);
+
+    // Count and time the stages of each run (default: off). The counters
+    // are reset when a run starts.
+    void setStats(bool enabled);
+
+    // Counters and timers of the latest run, or nullptr when disabled
+    const RunStats* stats() const { return stats_.get(); }
+
     // Get actual case-sensitive path
     std::optional<fs::path> getActualPath(const fs::path& path) const;
 
     // Process single HTML file
     void processFile(const fs::path& htmlFile);
 
-    // Make public for testing
+    // Call `visit` for every HTML file under `directory` as it is discovered
+    void forEachHtmlFile(const fs::path& directory,
+                         const std::function<void(const fs::path&)>& visit) const;
+
+    // Make public for testing and benchmarks
     std::vector<fs::path> findHtmlFiles(const fs::path& directory) const;
     std::string readFile(const fs::path& path) const;
+    bool comparePathsIgnoreCase(const fs::path& a, const fs::path& b) const;
 
-private:
     // Correct file references in HTML content
-    std::string correctFileReferences(const std::string& content, const fs::path& htmlFile);
+    std::string correctFileReferences(std::string_view content, const fs::path& htmlFile);
+    size_t correctFileReferences(std::string_view content, const fs::path& htmlFile, std::string& corrected);
+
+private:
+    // Files discovered ahead of the workers in parallel mode, per job. With
+    // async reads each queued file holds its contents, so fewer are queued.
+    static constexpr size_t kQueuedFilesPerJob = 64;
+    static constexpr size_t kQueuedBuffersPerJob = 4;
+
+    // While a run both lists directories and processes pages, one job in
+    // this many lists; it is I/O-bound and done long before the pages are
+    static constexpr unsigned kJobsPerListingThread = 4;
+
+    // State of one document while its references are collected
+    struct Document {
+        std::string_view content;
+        const fs::path& htmlFile;
+        DirectoryIndex& index;                // listings references resolve against
+        ReferenceCache* cache;                // nullptr resolves every reference afresh
+        std::vector<TextEdit> edits;
+        std::vector<fs::path>* dependencies;  // listings consulted, when tracked
+        PathTable::Id directory = PathTable::kNone;  // page's directory, on-disk case
+        bool onDisk = true;  // false: htmlFile is only where the page would be
+    };
+
+    // Process every HTML file under `startDir`, sequentially or on the pool
+    void runFiles(const fs::path& startDir);
+
+    // jobs_ split between listing and processing, when both run at once. A
+    // single listing job is the calling thread, which isn't one of jobs_.
+    unsigned listingJobs() const;
+    unsigned processingJobs() const;
+
+    // Pool of `threads` workers with room for the files queued ahead of
+    // them; null when there is only one job
+    std::unique_ptr<WorkStealingPool> makePool(unsigned threads) const;
+
+    // forEachHtmlFile, listing on `threads` threads
+    void walkHtmlFiles(const fs::path& directory, const std::function<void(const fs::path&)>& visit,
+                       unsigned threads) const;
+
+    // Process a page whose contents are already in memory
+    void processContent(const fs::path& htmlFile, std::string_view content);
+
+    // Is `htmlFile` large enough to be streamed?
+    bool streams(const fs::path& htmlFile) const;
+
+    // processContent for a page that is streamed instead
+    void processLargeFile(const fs::path& htmlFile);
+
+    // correctContent a window at a time, reading the page as it goes; when
+    // `hash` is set it is continued over everything read
+    bool correctStreaming(const fs::path& htmlFile, std::vector<fs::path>* dependencies, uint64_t* hash);
+
+    // Fix one page given its contents; returns true if it was rewritten
+    bool correctContent(const fs::path& htmlFile, std::string_view content,
+                        std::vector<fs::path>* dependencies);
+
+    // The pages `previous` records as depending on any of `changed`
+    static std::vector<fs::path> affectedPages(const Manifest& previous, const std::vector<fs::path>& changed);
 
-    // Process HTML node recursively
-    void processNode(GumboNode* node, const fs::path& htmlFile, std::string& content);
+    // Manifest and reverse index bookkeeping around correctContent
+    bool tracksManifest() const;
+    bool tracksDependencies() const;
+    bool isUpToDate(const fs::path& htmlFile);
+    // `hash` is the page's content hash when the caller read it and left it
+    // as it was; without one the page is read back to hash it
+    void recordDependencies(const fs::path& htmlFile, const std::vector<fs::path>& dependencies,
+                            std::optional<uint64_t> hash = std::nullopt);
+    // Save the manifest with each dependency's mtime from when it was listed
+    void saveManifest();
+    static bool isStrictAncestor(const fs::path& ancestor, const fs::path& path);
 
-    // Update attribute with correct case
-    void updateAttribute(GumboAttribute* attr, const fs::path& htmlFile, std::string& content);
+    // One batch of watch events: update the index, then correct what they affect
+    void processChanges(const fs::path& startDir, const std::vector<DirectoryWatcher::Event>& events);
+
+    // Correct each of `pages` that still exists, whatever the manifest says
+    void correctPages(const std::vector<fs::path>& pages);
+
+    static bool isHtmlName(std::string_view name);
+
+    // Does `page`, under the current run's root, belong to this shard?
+    bool inShard(const fs::path& page) const;
+    // Which of the root's entries this shard enters; empty when unsharded
+    DirectoryWatcher::TopLevelFilter shardFilter() const;
+
+    // Find the page's directory in on-disk case, which references resolve against
+    void locateDocument(Document& document);
+
+    // Parse the document and collect the edits that fix its references
+    void collectEdits(Document& document);
+
+    // Walk the tree under `node`, collecting edits against the document
+    void processNode(GumboNode* node, Document& document);
+
+    // Queue edits that rewrite the references in an attribute value in place
+    void updateAttribute(GumboAttribute* attr, ReferenceKind kind, Document& document);
+
+    // Same for the text of a <style> element
+    void updateStyleSheet(GumboNode* node, Document& document);
+
+    // Queue edits for the URLs held, as `kind` lays them out, by the value
+    // at [offset, offset + length) of the document
+    void updateValue(ReferenceKind kind, size_t offset, size_t length, Document& document);
+
+    // Queue an edit for the reference `value` found at `offset`, if its case is wrong
+    void updateReference(std::string_view value, size_t offset, Document& document);
 
     // Helper functions
-    bool comparePathsIgnoreCase(const fs::path& a, const fs::path& b) const;
-    void replaceInContent(std::string& content, const std::string& oldStr, const std::string& newStr);
+    MappedFile mapPage(const fs::path& htmlFile) const;
+    void count(RunStats::Counter counter, uint64_t amount = 1) const;
+    void recordWallTime(std::chrono::steady_clock::time_point started) const;
     void writeFile(const fs::path& path, const std::string& content) const;
+    void reportError(const fs::path& htmlFile, const std::exception& e) const;
+
+    unsigned jobs_ = 1;
+    unsigned shardIndex_ = 0;
+    unsigned shardCount_ = 1;
+    ParseEngine engine_ = ParseEngine::Gumbo;
+    IoEngine ioEngine_ = IoEngine::Sync;
+    std::atomic<size_t> skippedFiles_{0};
+    std::atomic<size_t> unchangedFiles_{0};
+    fs::path runRoot_;
+    fs::path manifestPath_;
+    std::unique_ptr<Manifest> manifest_;
+    bool dryRun_ = false;
+    fs::path snapshotPath_;
+    uint64_t streamingThreshold_ = kDefaultStreamingThreshold;
+    std::unique_ptr<ReverseIndex> reverseIndex_;  // only while watching
+    // Only while watching: its batches all run here, so neither threads nor
+    // their stats slots are created anew for each one
+    std::unique_ptr<WorkStealingPool> watchPool_;
+    std::unique_ptr<RewriteReport> report_;
+    std::unique_ptr<AtomicWriter> writer_;
+    std::unique_ptr<RunStats> stats_;
+    mutable std::mutex errorMutex_;
+
+    std::mutex watchMutex_;
+    DirectoryWatcher* watcher_ = nullptr;  // the running watch(), if any
+    bool stopRequested_ = false;
+    // While watching, other programs edit the pages, and may truncate one in
+    // place while it is mapped; pages are read into memory instead
+    bool readPages_ = false;
+
+    // Case-insensitive directory listings shared by every file in a run
+    mutable DirectoryIndex directoryIndex_;
+
+    // Outcomes of (directory, reference) pairs already resolved this run
+    ReferenceCache referenceCache_;
 };
 
+#endif // HTML_CASE_CORRECTOR_H
@@ -0,0 +1,175 @@
+#include <benchmark/benchmark.h>
+#include "html_case_corrector.h"
+#include "SyntheticTree.h"
+#include <fstream>
+#include <optional>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+// Tree shared by the micro-benchmarks; generated on first use, removed at exit
+struct SharedTree {
+    SyntheticTree tree;
+
+    SharedTree() {
+        tree = generateSyntheticTree(fs::temp_directory_path() / "html_case_bench_shared", SyntheticTreeOptions{});
+    }
+    ~SharedTree() {
+        std::error_code ec;
+        fs::remove_all(tree.root, ec);
+    }
+};
+
+const SyntheticTree& sharedTree() {
+    static SharedTree shared;
+    return shared.tree;
+}
+
+// Assets of the shared tree spelled as a careless author would
+std::vector<fs::path> scrambledAssets(size_t count) {
+    const SyntheticTree& tree = sharedTree();
+    std::vector<fs::path> paths;
+    for (size_t i = 0; i < count; ++i) {
+        const fs::path& asset = tree.assets[i % tree.assets.size()];
+        paths.push_back(tree.root / scrambleCase(asset.lexically_relative(tree.root).string(),
+                                                 static_cast<uint32_t>(i)));
+    }
+    return paths;
+}
+
+} // namespace
+
+static void BM_GetActualPath(benchmark::State& state) {
+    HtmlCaseCorrector corrector;
+    const std::vector<fs::path> paths = scrambledAssets(static_cast<size_t>(state.range(0)));
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(corrector.getActualPath(paths[next]));
+        next = (next + 1) % paths.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetActualPath)->Arg(64)->Arg(4096);
+
+// One index shared by every thread, as processDirectory's workers share
+// theirs: after each directory's first listing, lookups should scale with
+// the thread count. Thread 0 starts each run on a cold index.
+static void BM_ConcurrentResolve(benchmark::State& state) {
+    static DirectoryIndex index;
+    static std::vector<PathTable::Id> paths;
+    if (state.thread_index() == 0) {
+        index.clear();
+        paths.clear();
+        for (const fs::path& path : scrambledAssets(4096)) {
+            paths.push_back(index.paths().intern(path));
+        }
+    }
+    size_t next = static_cast<size_t>(state.thread_index()) * 997;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.resolve(paths[next % paths.size()]));
+        ++next;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentResolve)->ThreadRange(1, 64)->UseRealTime();
+
+static void BM_ComparePathsIgnoreCase(benchmark::State& state) {
+    HtmlCaseCorrector corrector;
+    const SyntheticTree& tree = sharedTree();
+    const std::vector<fs::path> scrambled = scrambledAssets(tree.assets.size());
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(corrector.comparePathsIgnoreCase(tree.assets[next], scrambled[next]));
+        next = (next + 1) % scrambled.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ComparePathsIgnoreCase);
+
+// What replaceInContent used to do: splice the planned fixes into the page
+static void BM_ApplyEdits(benchmark::State& state) {
+    HtmlCaseCorrector corrector;
+    DirectoryIndex index;
+    const fs::path& page = sharedTree().pages.back();
+    const std::string content = corrector.readFile(page);
+    const std::vector<TextEdit> edits = corrector.planEdits(content, page, index);
+    for (auto _ : state) {
+        std::vector<TextEdit> copy = edits;
+        benchmark::DoNotOptimize(applyEdits(content, copy));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+    state.counters["edits"] = static_cast<double>(edits.size());
+}
+BENCHMARK(BM_ApplyEdits);
+
+// Args are the engine and whether the corrector, and so its reference cache
+// and directory index, carries over between iterations. Cold runs give each
+// iteration a fresh corrector and so measure resolving every reference.
+static void BM_CorrectFileReferences(benchmark::State& state) {
+    const auto engine = static_cast<ParseEngine>(state.range(0));
+    const bool warm = state.range(1) != 0;
+    const fs::path& page = sharedTree().pages.back();
+    std::optional<HtmlCaseCorrector> corrector;
+    corrector.emplace();
+    const std::string content = corrector->readFile(page);
+    for (auto _ : state) {
+        if (!warm) {
+            state.PauseTiming();
+            corrector.emplace();
+            state.ResumeTiming();
+        }
+        corrector->setEngine(engine);
+        benchmark::DoNotOptimize(corrector->correctFileReferences(content, page));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+    state.SetLabel(std::string(engine == ParseEngine::Gumbo ? "gumbo" : "lexer") + (warm ? "/warm" : "/cold"));
+}
+BENCHMARK(BM_CorrectFileReferences)
+    ->Args({static_cast<int64_t>(ParseEngine::Gumbo), 0})
+    ->Args({static_cast<int64_t>(ParseEngine::Lexer), 0})
+    ->Args({static_cast<int64_t>(ParseEngine::Gumbo), 1})
+    ->Args({static_cast<int64_t>(ParseEngine::Lexer), 1});
+
+// End to end: args are worker threads (0 = one per core) and the fan-out
+// of a three-level tree. Each iteration fixes a freshly restored tree.
+static void BM_ProcessDirectory(benchmark::State& state) {
+    SyntheticTreeOptions options;
+    options.depth = 3;
+    options.fanOut = static_cast<unsigned>(state.range(1));
+    const SyntheticTree tree = generateSyntheticTree(fs::temp_directory_path() / "html_case_bench_tree", options);
+
+    std::unordered_map<std::string, std::string> originals;
+    HtmlCaseCorrector reader;
+    for (const auto& page : tree.pages) {
+        originals[page.string()] = reader.readFile(page);
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (const auto& [page, content] : originals) {
+            std::ofstream(page, std::ios::binary | std::ios::trunc) << content;
+        }
+        HtmlCaseCorrector corrector;
+        corrector.setJobs(static_cast<unsigned>(state.range(0)));
+        state.ResumeTiming();
+
+        corrector.processDirectory(tree.root);
+    }
+
+    const double files = static_cast<double>(tree.pages.size());
+    state.counters["files"] = files;
+    state.counters["files/s"] = benchmark::Counter(files, benchmark::Counter::kIsIterationInvariantRate);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * tree.pageBytes));
+
+    std::error_code ec;
+    fs::remove_all(tree.root, ec);
+}
+BENCHMARK(BM_ProcessDirectory)
+    ->Args({1, 4})
+    ->Args({0, 4})
+    ->Args({0, 8})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
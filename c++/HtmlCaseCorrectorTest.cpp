@@ -1,7 +1,25 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include "html_case_corrector.h"
+#include "PathTable.h"
+#include "Prefilter.h"
+#include "AttributeScanner.h"
+#include "BumpArena.h"
+#include "CaseFolding.h"
+#include "CssUrlScanner.h"
+#include "DirectoryWalker.h"
+#include "DirectoryWatcher.h"
+#include "IndexSnapshot.h"
+#include "RewriteReport.h"
+#include "SlotArray.h"
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <thread>
+#if defined(__linux__)
+#include <sys/xattr.h>
+#endif
 
 class HtmlCaseCorrectorTest : public ::testing::Test {
 protected:
@@ -44,6 +62,44 @@ TEST_F(HtmlCaseCorrectorTest, FindsHtmlFiles) {
     ));
 }
 
+TEST_F(HtmlCaseCorrectorTest, ForEachHtmlFileStreamsMatches) {
+    createFile(tempDir / "a.html", "<html></html>");
+    createFile(tempDir / "b.txt", "text file");
+    createFile(tempDir / "sub" / "c.HTM", "<html></html>");
+
+    std::vector<std::string> fileNames;
+    corrector.forEachHtmlFile(tempDir, [&fileNames](const fs::path& file) {
+        fileNames.push_back(file.filename().string());
+    });
+
+    EXPECT_THAT(fileNames, testing::UnorderedElementsAre("a.html", "c.HTM"));
+}
+
+TEST_F(HtmlCaseCorrectorTest, DirectoryWalkerListsTreeIntoIndex) {
+    for (int i = 0; i < 40; ++i) {
+        createFile(tempDir / ("D" + std::to_string(i % 5)) / ("Sub" + std::to_string(i)) / "Page.html", "");
+    }
+    createFile(tempDir / "skip.txt", "");
+    fs::create_directory_symlink(tempDir / "D0", tempDir / "Linked");
+    fs::create_symlink(tempDir / "D1" / "Sub1" / "Page.html", tempDir / "Alias.html");
+
+    DirectoryIndex index;
+    DirectoryWalker walker(3, &index);
+    std::vector<fs::path> files;
+    walker.walk(tempDir,
+                [](std::string_view name) { return name.size() > 5 && name.substr(name.size() - 5) == ".html"; },
+                [&files](const fs::path& file) { files.push_back(file); });
+
+    // Symlinked directories aren't followed; symlinked files are reported
+    EXPECT_EQ(files.size(), 41u);
+    EXPECT_THAT(files, testing::Contains(tempDir / "Alias.html"));
+
+    // Listings were published during the walk, not re-read on lookup
+    fs::remove(tempDir / "skip.txt");
+    EXPECT_EQ(index.lookup(tempDir, "SKIP.TXT"), std::optional<std::string>("skip.txt"));
+    EXPECT_EQ(index.lookup(tempDir / "D3", "sub8"), std::optional<std::string>("Sub8"));
+}
+
 TEST_F(HtmlCaseCorrectorTest, GetActualPathFindsCorrectCase) {
     // Create files with specific case
     createFile(tempDir / "Test.jpg", "");
@@ -63,6 +119,111 @@ TEST_F(HtmlCaseCorrectorTest, GetActualPathFindsCorrectCase) {
     EXPECT_FALSE(actualPath3.has_value());
 }
 
+TEST_F(HtmlCaseCorrectorTest, GetActualPathFixesEveryComponent) {
+    createFile(tempDir / "images" / "sub" / "logo.png", "");
+    createFile(tempDir / "images" / "sub" / "icon.png", "");
+
+    auto logo = corrector.getActualPath(tempDir / "IMAGES" / "Sub" / "logo.PNG");
+    ASSERT_TRUE(logo.has_value());
+    EXPECT_EQ(*logo, tempDir / "images" / "sub" / "logo.png");
+
+    // Sibling reuses the resolved prefix
+    auto icon = corrector.getActualPath(tempDir / "Images" / "SUB" / "Icon.png");
+    ASSERT_TRUE(icon.has_value());
+    EXPECT_EQ(*icon, tempDir / "images" / "sub" / "icon.png");
+
+    EXPECT_FALSE(corrector.getActualPath(tempDir / "IMAGES" / "Missing" / "logo.png").has_value());
+}
+
+TEST_F(HtmlCaseCorrectorTest, DirectoryIndexIsRefreshedPerRun) {
+    createFile(tempDir / "Old.jpg", "");
+
+    // First lookup lists the directory; later lookups are served from the index
+    ASSERT_TRUE(corrector.getActualPath(tempDir / "old.jpg").has_value());
+    createFile(tempDir / "New.jpg", "");
+    EXPECT_FALSE(corrector.getActualPath(tempDir / "new.jpg").has_value());
+
+    // A new run starts from a fresh index
+    corrector.processDirectory(tempDir);
+    auto actualPath = corrector.getActualPath(tempDir / "new.jpg");
+    ASSERT_TRUE(actualPath.has_value());
+    EXPECT_EQ(actualPath->filename(), "New.jpg");
+}
+
+TEST_F(HtmlCaseCorrectorTest, KeepsExactMatchesAmongNamesThatFoldAlike) {
+    // Only a case-sensitive filesystem can hold both
+    createFile(tempDir / "Logo.png", "");
+    createFile(tempDir / "logo.png", "");
+    if (std::distance(fs::directory_iterator(tempDir), fs::directory_iterator()) != 2) {
+        GTEST_SKIP() << "filesystem folds case";
+    }
+    const std::string page = R"(<img src="logo.png"><img src="Logo.png">)";
+    createFile(tempDir / "index.html", page);
+
+    corrector.processFile(tempDir / "index.html");
+    EXPECT_EQ(corrector.readFile(tempDir / "index.html"), page);
+    EXPECT_THAT(corrector.getActualPath(tempDir / "LOGO.PNG").value().filename().string(),
+                testing::AnyOf("Logo.png", "logo.png"));
+}
+
+TEST(SlotArrayTest, SlotsKeepTheirAddressAsItGrows) {
+    SlotArray<std::atomic<uint32_t>> slots;
+    std::atomic<uint32_t>* early = &slots.at(5);
+    slots.at(1u << 20).store(7);
+    EXPECT_EQ(&slots.at(5), early);
+    EXPECT_EQ(slots.find(1u << 21), nullptr);
+    uint32_t visited = PathTable::kNone;
+    slots.forEach([&visited](uint32_t id, const std::atomic<uint32_t>& slot) {
+        if (slot.load() == 7) {
+            visited = id;
+        }
+    });
+    EXPECT_EQ(visited, 1u << 20);
+}
+
+TEST_F(HtmlCaseCorrectorTest, ConcurrentLookupsShareOneListingPerDirectory) {
+    constexpr int kDirectories = 8;
+    constexpr int kFiles = 32;
+    for (int d = 0; d < kDirectories; ++d) {
+        for (int f = 0; f < kFiles; ++f) {
+            createFile(tempDir / ("Dir" + std::to_string(d)) / ("File" + std::to_string(f) + ".TXT"), "");
+        }
+    }
+
+    // Every thread starts on a different directory, while the walker
+    // publishes the same listings underneath them
+    DirectoryIndex index;
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 16; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kDirectories * kFiles; ++i) {
+                const int d = (t + i / kFiles) % kDirectories;
+                const int f = i % kFiles;
+                const std::string name = "file" + std::to_string(f) + ".txt";
+                auto actual = index.resolve(tempDir / ("dir" + std::to_string(d)) / name);
+                if (!actual || actual->filename() != "File" + std::to_string(f) + ".TXT") {
+                    ++wrong;
+                }
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        DirectoryWalker walker(2, &index);
+        walker.walk(tempDir, [](std::string_view) { return false; }, [](const fs::path&) {});
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(wrong.load(), 0);
+
+    // Listed once: a file created after the first lookup isn't seen
+    createFile(tempDir / "Dir0" / "Late.txt", "");
+    EXPECT_FALSE(index.lookup(tempDir / "Dir0", "late.txt").has_value());
+    index.forget(tempDir / "Dir0");
+    EXPECT_EQ(index.lookup(tempDir / "Dir0", "late.txt"), std::optional<std::string>("Late.txt"));
+}
+
 TEST_F(HtmlCaseCorrectorTest, CorrectFileReferencesFixesCase) {
     // Create test files with specific case
     createFile(tempDir / "Images" / "Test.jpg", "");
@@ -92,6 +253,211 @@ TEST_F(HtmlCaseCorrectorTest, CorrectFileReferencesFixesCase) {
     ));
 }
 
+TEST_F(HtmlCaseCorrectorTest, RewritesOnlyAttributeValues) {
+    createFile(tempDir / "Images" / "Test.jpg", "");
+
+    std::string htmlContent =
+        "<p>images/test.jpg</p>\n"
+        "<img src=\"images/test.jpg\">\n"
+        "<script>var img = 'images/test.jpg';</script>\n";
+
+    fs::path htmlFile = tempDir / "index.html";
+    createFile(htmlFile, htmlContent);
+
+    corrector.processFile(htmlFile);
+
+    EXPECT_EQ(corrector.readFile(htmlFile),
+        "<p>images/test.jpg</p>\n"
+        "<img src=\"Images/Test.jpg\">\n"
+        "<script>var img = 'images/test.jpg';</script>\n");
+}
+
+TEST(PathTableTest, InternsComponentsOnce) {
+    PathTable paths;
+    const PathTable::Id site = paths.intern(fs::path("/srv/site"));
+    const PathTable::Id page = paths.intern(site, "docs/index.html");
+    const PathTable::Id other = paths.intern(fs::path("/srv/site/docs/index.html"));
+
+    EXPECT_EQ(page, other);
+    EXPECT_EQ(paths.toString(page), "/srv/site/docs/index.html");
+    EXPECT_EQ(paths.intern(site, "docs//index.html"), page);
+    EXPECT_EQ(paths.toString(paths.intern(site, "/etc/x")), "/etc/x");
+
+    // Relative paths walk through the closest common ancestor
+    const PathTable::Id images = paths.intern(site, "img/a.png");
+    EXPECT_EQ(paths.relative(paths.parent(page), images), "../img/a.png");
+    EXPECT_EQ(paths.relative(site, site), ".");
+    EXPECT_EQ(paths.relative(paths.intern(fs::path("rel")), images), "/srv/site/img/a.png");
+
+    const size_t nodes = paths.size();
+    paths.intern(site, "docs/index.html");
+    EXPECT_EQ(paths.size(), nodes);
+}
+
+TEST_F(HtmlCaseCorrectorTest, KeepsReferenceStructure) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    createFile(tempDir / "Docs" / "Page.html", "");
+
+    std::string htmlContent = R"(<img src="./images//logo.PNG#top">)"
+                              R"(<a href="docs/../docs/page.html?x=IMAGES">)"
+                              R"(<a href="docs/">)";
+    fs::path htmlFile = tempDir / "index.html";
+    createFile(htmlFile, htmlContent);
+
+    corrector.processFile(htmlFile);
+    EXPECT_EQ(corrector.readFile(htmlFile),
+              R"(<img src="./Images//Logo.png#top">)"
+              R"(<a href="Docs/../Docs/Page.html?x=IMAGES">)"
+              R"(<a href="Docs/">)");
+}
+
+TEST_F(HtmlCaseCorrectorTest, ReusesResolvedReferences) {
+    createFile(tempDir / "Css" / "Style.css", "");
+    for (int i = 0; i < 10; ++i) {
+        createFile(tempDir / "pages" / ("p" + std::to_string(i) + ".html"),
+                   R"(<link href="../css/style.CSS"><img src="../missing.png">)");
+    }
+
+    corrector.processDirectory(tempDir);
+
+    // One miss per distinct reference; the rest, negative entries included, hit
+    EXPECT_EQ(corrector.referenceCache().misses(), 2u);
+    EXPECT_EQ(corrector.referenceCache().hits(), 18u);
+    EXPECT_THAT(corrector.readFile(tempDir / "pages" / "p7.html"), testing::HasSubstr("../Css/Style.css"));
+}
+
+TEST_F(HtmlCaseCorrectorTest, LeavesNonLocalReferencesUnresolved) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    const std::string htmlContent = R"(<a href="https://example.com/Images/logo.png">)"
+                                    R"(<img src="//cdn.example.com/logo.png">)"
+                                    R"(<a href="mailto:a@b.c"><img src="images/logo.png">)";
+    fs::path htmlFile = tempDir / "index.html";
+    createFile(htmlFile, htmlContent);
+
+    corrector.processFile(htmlFile);
+
+    // Only the local reference was looked up at all
+    EXPECT_EQ(corrector.referenceCache().misses(), 1u);
+    EXPECT_EQ(corrector.readFile(htmlFile),
+              R"(<a href="https://example.com/Images/logo.png">)"
+              R"(<img src="//cdn.example.com/logo.png">)"
+              R"(<a href="mailto:a@b.c"><img src="Images/Logo.png">)");
+}
+
+TEST(ReferenceCacheTest, EvictsLeastRecentlyUsedPastBudget) {
+    ReferenceCache cache(32 * 200);  // roughly one entry per shard
+    ReferenceCache::Outcome outcome;
+    outcome.resolved = true;
+    for (int i = 0; i < 1000; ++i) {
+        cache.insert(1, "ref" + std::to_string(i), outcome);
+    }
+    EXPECT_LE(cache.size(), 64u);
+    EXPECT_GE(cache.evictions(), 1000u - 64u);
+
+    ReferenceCache::Outcome found;
+    EXPECT_TRUE(cache.find(1, "ref999", found));
+    EXPECT_FALSE(cache.find(1, "ref0", found));
+}
+
+TEST_F(HtmlCaseCorrectorTest, FixesSrcsetPosterAndCssReferences) {
+    createFile(tempDir / "Img" / "A.png", "");
+    createFile(tempDir / "Img" / "B@2x.png", "");
+    createFile(tempDir / "Media" / "Poster.jpg", "");
+    createFile(tempDir / "Css" / "Base.css", "");
+
+    const std::string htmlContent =
+        R"(<img srcset="img/a.png 1x, img/b@2x.PNG 2x" src="img/A.PNG">)"
+        R"(<video poster="media/poster.JPG"></video>)"
+        R"(<div style="background: url(img/a.png) no-repeat"></div>)"
+        R"(<p poster="img/a.png">)"
+        "<style>@import 'css/base.CSS'; /* url(img/a.png) */ p { background: url(\"IMG/A.PNG\") }</style>";
+    const std::string expected =
+        R"(<img srcset="Img/A.png 1x, Img/B@2x.png 2x" src="Img/A.png">)"
+        R"(<video poster="Media/Poster.jpg"></video>)"
+        R"(<div style="background: url(Img/A.png) no-repeat"></div>)"
+        R"(<p poster="img/a.png">)"
+        "<style>@import 'Css/Base.css'; /* url(img/a.png) */ p { background: url(\"Img/A.png\") }</style>";
+
+    for (ParseEngine engine : {ParseEngine::Gumbo, ParseEngine::Lexer}) {
+        fs::path htmlFile = tempDir / "index.html";
+        createFile(htmlFile, htmlContent);
+        corrector.setEngine(engine);
+        corrector.processDirectory(tempDir);
+        EXPECT_EQ(corrector.readFile(htmlFile), expected);
+    }
+}
+
+TEST(CssUrlScannerTest, ReportsUrlArguments) {
+    const std::string css = R"css(a{b:url( "x.png" )} c{d:URL(y.png)} e{f:url(z\).png)} g{content:"url(no)"})css";
+    std::vector<std::string> urls;
+    scanCssUrls(css, [&](size_t offset, size_t length) { urls.push_back(css.substr(offset, length)); });
+    EXPECT_THAT(urls, testing::ElementsAre("x.png", "y.png"));
+}
+
+TEST_F(HtmlCaseCorrectorTest, CorrectsInMemoryDocumentsAgainstSuppliedIndex) {
+    // Nothing under this root exists on disk
+    DirectoryIndex index(DirectoryIndex::Source::Supplied);
+    index.addPath("bucket/site/Images/Logo.png");
+    index.addPath("bucket/site/Docs/Guide.html");
+
+    const std::string page = R"(<img src="../images/logo.PNG"><a href="guide.HTML#top">)";
+    const fs::path htmlFile = "bucket/site/docs/index.html";
+
+    auto edits = corrector.planEdits(page, htmlFile, index);
+    ASSERT_EQ(edits.size(), 2u);
+    EXPECT_EQ(edits[0].offset, 10u);
+    EXPECT_EQ(edits[0].replacement, "../Images/Logo.png");
+    EXPECT_EQ(corrector.correctDocument(page, htmlFile, index),
+              R"(<img src="../Images/Logo.png"><a href="Guide.html#top">)");
+    EXPECT_FALSE(fs::exists("bucket"));
+}
+
+TEST_F(HtmlCaseCorrectorTest, TrustedDirectoriesAreNeverListed) {
+    // Nothing above the site is listed, as with an execute-only ancestor
+    const fs::path site = "/srv/site";
+    auto supplied = [&site](DirectoryIndex& index) {
+        index.insert(site, {"Images"});
+        index.insert(site / "Images", {"Logo.png"});
+    };
+    DirectoryIndex untrusted(DirectoryIndex::Source::Supplied);
+    supplied(untrusted);
+    EXPECT_FALSE(untrusted.resolve(site / "images" / "logo.png").has_value());
+
+    DirectoryIndex index(DirectoryIndex::Source::Supplied);
+    supplied(index);
+    index.trust(index.paths().intern(site));
+    EXPECT_EQ(index.resolve(site / "images" / "logo.png"), std::optional<fs::path>(site / "Images" / "Logo.png"));
+    std::vector<fs::path> listed;
+    index.dependencies(index.paths().intern(site / "images" / "logo.png"), listed);
+    EXPECT_THAT(listed, testing::ElementsAre(site / "Images", site));
+}
+
+TEST_F(HtmlCaseCorrectorTest, ListedMtimesPredateTheListing) {
+    createFile(tempDir / "Same" / "Logo.png", "");
+    createFile(tempDir / "Added" / "Logo.png", "");
+    DirectoryIndex index;
+    index.setRecordMtimes(true);
+    EXPECT_FALSE(index.listedMtime(tempDir / "Same").has_value());
+    ASSERT_TRUE(index.resolve(tempDir / "same" / "logo.png").has_value());
+    ASSERT_TRUE(index.resolve(tempDir / "added" / "logo.png").has_value());
+    EXPECT_EQ(index.listedMtime(tempDir / "Same"), DirectoryIndex::mtimeOf(tempDir / "Same"));
+
+    // A page replaced in place moves the mtime but leaves the same names;
+    // a new file means the listing no longer tells what is there
+    const auto later = fs::last_write_time(tempDir / "Same") + std::chrono::seconds(5);
+    fs::last_write_time(tempDir / "Same", later);
+    EXPECT_EQ(index.listedMtime(tempDir / "Same"), DirectoryIndex::mtimeOf(tempDir / "Same"));
+    createFile(tempDir / "Added" / "New.png", "");
+    fs::last_write_time(tempDir / "Added", fs::last_write_time(tempDir / "Added") + std::chrono::seconds(5));
+    EXPECT_EQ(index.listedMtime(tempDir / "Added"), DirectoryIndex::kNoMtime);
+}
+
+TEST(SpliceRewriterTest, AppliesEditsInOffsetOrder) {
+    std::vector<TextEdit> edits = {{8, 3, "XYZ"}, {0, 3, "a"}, {9, 1, "overlap"}};
+    EXPECT_EQ(applyEdits("abc def ghi", edits), "a def XYZ");
+    EXPECT_EQ(edits.size(), 2u);
+}
+
 TEST_F(HtmlCaseCorrectorTest, HandlesSpecialCharacters) {
     // Create test files with UTF-8 names
     createFile(tempDir / "Изображение.jpg", "");
@@ -118,6 +484,20 @@ TEST_F(HtmlCaseCorrectorTest, HandlesSpecialCharacters) {
     ));
 }
 
+TEST(CaseFoldingTest, FoldsBeyondAscii) {
+    EXPECT_EQ(foldCase("Straße/ÄÖÜ.HTML"), "straße/äöü.html");
+    EXPECT_EQ(foldCase("ΣΟΦΊΑ"), "σοφία");
+    EXPECT_TRUE(equalsIgnoreCase("Документы", "документы"));
+    EXPECT_TRUE(equalsIgnoreCase("\xE2\x84\xAA", "k"));  // kelvin sign
+    EXPECT_FALSE(equalsIgnoreCase("Ärger", "arger"));
+
+    // Invalid UTF-8 passes through byte for byte
+    const std::string invalid = "A\xFF\xC3";
+    EXPECT_EQ(foldCase(invalid), "a\xFF\xC3");
+    EXPECT_EQ(foldedSize(invalid), 3u);
+    EXPECT_EQ(foldedSize("\xE2\x84\xAA"), 1u);
+}
+
 TEST_F(HtmlCaseCorrectorTest, HandlesSymlinks) {
     // Create real directory and symlink
     fs::path realDir = tempDir / "RealDir";
@@ -138,6 +518,449 @@ TEST_F(HtmlCaseCorrectorTest, HandlesSymlinks) {
     EXPECT_THAT(corrected, testing::HasSubstr("Image.jpg"));
 }
 
+TEST_F(HtmlCaseCorrectorTest, ParallelProcessDirectoryFixesEveryFile) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    for (int i = 0; i < 64; ++i) {
+        createFile(tempDir / ("dir" + std::to_string(i % 8)) / ("page" + std::to_string(i) + ".html"),
+                   R"(<img src="../images/logo.PNG">)");
+    }
+
+    corrector.setJobs(4);
+    corrector.processDirectory(tempDir);
+
+    for (int i = 0; i < 64; ++i) {
+        std::string corrected = corrector.readFile(
+            tempDir / ("dir" + std::to_string(i % 8)) / ("page" + std::to_string(i) + ".html"));
+        EXPECT_THAT(corrected, testing::HasSubstr("Images/Logo.png"));
+    }
+}
+
+TEST_F(HtmlCaseCorrectorTest, PrefilterSkipsFilesWithoutLocalReferences) {
+    createFile(tempDir / "Test.jpg", "");
+    createFile(tempDir / "none.html", "<p>No references at all</p>");
+    createFile(tempDir / "remote.html",
+        "<img src=\"http://example.com/test.jpg\"><a href='#top'></a><a HREF = 'mailto:a@b.c'></a>");
+    createFile(tempDir / "local.html", "<img data-x='1' src=\"test.jpg\">");
+
+    corrector.processDirectory(tempDir);
+
+    EXPECT_EQ(corrector.skippedFiles(), 2u);
+    EXPECT_THAT(corrector.readFile(tempDir / "local.html"), testing::HasSubstr("Test.jpg"));
+}
+
+TEST(PrefilterTest, FindsCandidatesAcrossBlockBoundaries) {
+    std::string padding(100, 'x');
+    EXPECT_FALSE(mayContainLocalReference(padding));
+    EXPECT_TRUE(mayContainLocalReference(padding + "<img src=a.png>"));
+    EXPECT_TRUE(mayContainLocalReference(padding.substr(0, 29) + "href\n=\n\"IMG/a.png\""));
+    EXPECT_FALSE(mayContainLocalReference(padding + "<a href=\"https://x\" class=\"y\">"));
+    EXPECT_TRUE(mayContainLocalReference("<img src='c:/images/a.png'>"));
+    EXPECT_TRUE(mayContainLocalReference("<img srcset=\"https://cdn/x.png 1x, IMG/Local.png 2x\">"));
+    EXPECT_FALSE(mayContainLocalReference("<img srcset=\"\">"));
+    EXPECT_TRUE(mayContainLocalReference("<style>@IMPORT \"Style.css\";</style>"));
+}
+
+TEST(BumpArenaTest, ResetReusesMemory) {
+    BumpArena arena(256);
+
+    void* first = arena.allocate(3);
+    void* second = arena.allocate(40);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % 16, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % 16, 0u);
+
+    // Larger than a chunk, forcing a new one
+    EXPECT_NE(arena.allocate(1000), nullptr);
+    EXPECT_EQ(arena.bytesUsed(), 16u + 48u + 1008u);
+
+    arena.reset();
+    EXPECT_EQ(arena.bytesUsed(), 0u);
+    void* reused = arena.allocate(1000);
+    arena.allocate(200);
+    arena.reset();
+    EXPECT_EQ(arena.allocate(1000), reused);
+}
+
+TEST_F(HtmlCaseCorrectorTest, HandlesDeeplyNestedDocuments) {
+    createFile(tempDir / "Test.jpg", "");
+
+    std::string htmlContent;
+    const int depth = 20000;
+    for (int i = 0; i < depth; ++i) {
+        htmlContent += "<div>";
+    }
+    htmlContent += "<img src=\"test.jpg\">";
+    for (int i = 0; i < depth; ++i) {
+        htmlContent += "</div>";
+    }
+
+    fs::path htmlFile = tempDir / "deep.html";
+    createFile(htmlFile, htmlContent);
+
+    corrector.processFile(htmlFile);
+
+    EXPECT_THAT(corrector.readFile(htmlFile), testing::HasSubstr("<img src=\"Test.jpg\">"));
+}
+
+TEST_F(HtmlCaseCorrectorTest, ManifestSkipsUnchangedPages) {
+    fs::path manifest = fs::temp_directory_path() / "html_case_test_manifest";
+    createFile(tempDir / "Images" / "Logo.png", "");
+    createFile(tempDir / "a.html", R"(<img src="images/logo.png">)");
+    createFile(tempDir / "b.html", R"(<img src="images/new.png">)");
+    createFile(tempDir / "c.html", "<p>No references</p>");
+
+    {
+        HtmlCaseCorrector first;
+        first.setManifest(manifest);
+        first.processDirectory(tempDir);
+        EXPECT_EQ(first.unchangedFiles(), 0u);
+    }
+    {
+        HtmlCaseCorrector second;
+        second.setManifest(manifest);
+        second.processDirectory(tempDir);
+        EXPECT_EQ(second.unchangedFiles(), 3u);
+    }
+
+    // A new asset changes the directory that a.html and b.html depend on
+    createFile(tempDir / "Images" / "New.png", "");
+    {
+        HtmlCaseCorrector third;
+        third.setManifest(manifest);
+        third.processDirectory(tempDir);
+        EXPECT_EQ(third.unchangedFiles(), 1u);
+    }
+    EXPECT_THAT(corrector.readFile(tempDir / "a.html"), testing::HasSubstr("Images/Logo.png"));
+    EXPECT_THAT(corrector.readFile(tempDir / "b.html"), testing::HasSubstr("Images/New.png"));
+
+    fs::remove(manifest);
+}
+
+TEST_F(HtmlCaseCorrectorTest, AffectedByCorrectsOnlyPagesReferencingTheChange) {
+    fs::path manifest = fs::temp_directory_path() / "html_case_test_manifest";
+    createFile(tempDir / "Images" / "Logo.png", "");
+    createFile(tempDir / "Docs" / "Icons" / "Home.png", "");
+    createFile(tempDir / "a.html", R"(<img src="Images/Logo.png">)");
+    createFile(tempDir / "b.html", R"(<img src="Docs/Icons/Home.png">)");
+    createFile(tempDir / "c.html", "<p>No references</p>");
+
+    corrector.setManifest(manifest);
+    corrector.processDirectory(tempDir);
+
+    // A bulk rename inside one asset directory; the query may use any case
+    fs::rename(tempDir / "Images" / "Logo.png", tempDir / "Images" / "LOGO.png");
+    EXPECT_THAT(corrector.affectedPages({tempDir / "images"}), testing::ElementsAre(tempDir / "a.html"));
+    EXPECT_THAT(corrector.affectedPages({tempDir / "Docs"}), testing::ElementsAre(tempDir / "b.html"));
+
+    corrector.processAffected(tempDir, {tempDir / "Images"});
+    EXPECT_EQ(corrector.readFile(tempDir / "a.html"), R"(<img src="Images/LOGO.png">)");
+
+    // Pages it didn't visit are still in the manifest
+    HtmlCaseCorrector next;
+    next.setManifest(manifest);
+    next.processDirectory(tempDir);
+    EXPECT_EQ(next.unchangedFiles(), 3u);
+
+    fs::remove(manifest);
+}
+
+TEST_F(HtmlCaseCorrectorTest, WatchCorrectsNewPagesAndPagesAffectedByNewAssets) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    createFile(tempDir / "a.html", R"(<img src="images/new.png">)");
+
+    std::thread watcher([this] { corrector.watch(tempDir); });
+    auto eventually = [this](const fs::path& page, const std::string& expected) {
+        for (int i = 0; i < 200 && corrector.readFile(page) != expected; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return corrector.readFile(page);
+    };
+
+    // Uploaded after the first pass may have run: fixed by its own event
+    createFile(tempDir / "Docs" / "b.html", R"(<img src="../images/logo.png">)");
+    EXPECT_EQ(eventually(tempDir / "Docs" / "b.html", R"(<img src="../Images/Logo.png">)"),
+              R"(<img src="../Images/Logo.png">)");
+
+    // a.html is untouched, but the asset it was missing just arrived
+    createFile(tempDir / "Images" / "New.png", "");
+    EXPECT_EQ(eventually(tempDir / "a.html", R"(<img src="Images/New.png">)"),
+              R"(<img src="Images/New.png">)");
+
+    corrector.stopWatching();
+    watcher.join();
+}
+
+TEST_F(HtmlCaseCorrectorTest, WatcherReportsPagesInDirectoriesFilledBeforeTheirWatch) {
+    std::unique_ptr<DirectoryWatcher> watcher = DirectoryWatcher::create(tempDir);
+    if (!watcher) {
+        GTEST_SKIP() << "no inotify";
+    }
+
+    // Written and closed before the watcher learns of its directory
+    createFile(tempDir / "New" / "Deeper" / "p.html", "<p>Done</p>");
+
+    std::vector<DirectoryWatcher::Event> events;
+    ASSERT_TRUE(watcher->wait(events));
+    auto page = std::find_if(events.begin(), events.end(), [](const DirectoryWatcher::Event& event) {
+        return event.name == "p.html";
+    });
+    ASSERT_NE(page, events.end());
+    EXPECT_EQ(page->kind, DirectoryWatcher::Event::Kind::MovedIn);
+    EXPECT_EQ(page->directory, tempDir / "New" / "Deeper");
+}
+
+TEST_F(HtmlCaseCorrectorTest, WatcherOnlyWatchesTheSubtreesItKeeps) {
+    createFile(tempDir / "Mine" / "Sub" / "a.html", "");
+    createFile(tempDir / "Theirs" / "Sub" / "b.html", "");
+    auto keep = [](std::string_view name, bool) { return name != "Theirs" && name != "Later"; };
+    std::unique_ptr<DirectoryWatcher> watcher = DirectoryWatcher::create(tempDir, keep);
+    if (!watcher) {
+        GTEST_SKIP() << "no inotify";
+    }
+    EXPECT_EQ(watcher->size(), 3u);
+
+    // Directories arriving later are filtered the same way, though the
+    // root still reports them
+    createFile(tempDir / "Later" / "c.html", "");
+    std::vector<DirectoryWatcher::Event> events;
+    ASSERT_TRUE(watcher->wait(events));
+    EXPECT_EQ(watcher->size(), 3u);
+    EXPECT_THAT(events, testing::Contains(testing::Field(&DirectoryWatcher::Event::name, "Later")));
+    EXPECT_THAT(events, testing::Not(testing::Contains(testing::Field(&DirectoryWatcher::Event::name, "c.html"))));
+}
+
+TEST_F(HtmlCaseCorrectorTest, StatsCountEveryStageOfARun) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    createFile(tempDir / "a.html", R"(<img src="images/logo.png"><img src="images/logo.png">)");
+    createFile(tempDir / "b.html", R"(<img src="Images/Logo.png"><a href="missing.html">)");
+    createFile(tempDir / "c.html", "<p>No references</p>");
+
+    corrector.setStats(true);
+    corrector.processDirectory(tempDir);
+    const RunStats::Totals totals = corrector.stats()->totals();
+
+    EXPECT_EQ(totals.count(RunStats::Counter::FilesScanned), 3u);
+    EXPECT_EQ(totals.count(RunStats::Counter::FilesSkipped), 1u);
+    EXPECT_EQ(totals.count(RunStats::Counter::FilesRewritten), 1u);
+    EXPECT_EQ(totals.count(RunStats::Counter::ReferencesResolved), 3u);
+    EXPECT_EQ(totals.count(RunStats::Counter::ReferencesUnresolved), 1u);
+    EXPECT_EQ(totals.count(RunStats::Counter::ReferencesCorrected), 2u);
+    EXPECT_GE(totals.count(RunStats::Counter::CacheHits), 1u);
+    EXPECT_EQ(totals.calls[static_cast<size_t>(RunStats::Timer::Parse)], 2u);
+    EXPECT_EQ(totals.calls[static_cast<size_t>(RunStats::Timer::Write)], 1u);
+    EXPECT_GT(totals.wallNanoseconds, 0u);
+
+    EXPECT_THAT(RunStats::json(totals), testing::HasSubstr("\"files_rewritten\":1"));
+    EXPECT_THAT(RunStats::prometheus(totals),
+                testing::HasSubstr("html_case_corrector_references_unresolved_total 1\n"));
+
+    // A second run starts from zero
+    corrector.processDirectory(tempDir);
+    EXPECT_EQ(corrector.stats()->totals().count(RunStats::Counter::FilesRewritten), 0u);
+}
+
+TEST_F(HtmlCaseCorrectorTest, StatsExportsKeepLargeTotalsExact) {
+    // Totals past a double's 53-bit mantissa come back exactly
+    RunStats::Totals large;
+    large.counts[static_cast<size_t>(RunStats::Counter::FilesRewritten)] = (1ull << 60) + 1;
+    large.nanoseconds[static_cast<size_t>(RunStats::Timer::Write)] = (1ull << 60) + 1;
+    RunStats::save(large, tempDir / "large.json");
+    const RunStats::Totals loaded = RunStats::load(tempDir / "large.json");
+    EXPECT_EQ(loaded.count(RunStats::Counter::FilesRewritten), (1ull << 60) + 1);
+    EXPECT_EQ(loaded.nanoseconds[static_cast<size_t>(RunStats::Timer::Write)], (1ull << 60) + 1);
+}
+
+TEST_F(HtmlCaseCorrectorTest, IndexSnapshotServesUnchangedDirectories) {
+    createFile(tempDir / "site" / "Images" / "Logo.png", "");
+    createFile(tempDir / "site" / "Images" / "Old.png", "");
+    createFile(tempDir / "site" / "a.html", R"(<img src="images/logo.png">)");
+    // Listings younger than the filesystem's timestamp granularity aren't saved
+    const auto past = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    fs::last_write_time(tempDir / "site" / "Images", past);
+    const fs::path snapshotPath = tempDir / "index.snapshot";
+
+    corrector.setIndexSnapshot(snapshotPath);
+    corrector.processDirectory(tempDir / "site");
+    EXPECT_EQ(corrector.readFile(tempDir / "site" / "a.html"), R"(<img src="Images/Logo.png">)");
+
+    {
+        IndexSnapshot snapshot(snapshotPath);
+        const uint32_t images = snapshot.find(fs::absolute(tempDir / "site" / "Images").string());
+        ASSERT_NE(images, IndexSnapshot::kNotFound);
+        EXPECT_EQ(snapshot.lookup(images, "old.png"), std::optional<std::string_view>("Old.png"));
+        EXPECT_EQ(snapshot.lookup(images, "missing.png"), std::nullopt);
+        // The page's directory changed when it was rewritten
+        EXPECT_EQ(snapshot.find(fs::absolute(tempDir / "site").string()), IndexSnapshot::kNotFound);
+    }
+
+    // Renamed behind the snapshot's back with the mtime put back: the
+    // listing is trusted, which shows the directory isn't read again
+    fs::rename(tempDir / "site" / "Images" / "Old.png", tempDir / "site" / "Images" / "Older.png");
+    fs::last_write_time(tempDir / "site" / "Images", past);
+    DirectoryIndex trusting;
+    ASSERT_TRUE(trusting.loadSnapshot(snapshotPath));
+    EXPECT_EQ(trusting.lookup(tempDir / "site" / "Images", "OLD.PNG"), std::optional<std::string>("Old.png"));
+
+    // A changed mtime sends it back to the disk
+    fs::last_write_time(tempDir / "site" / "Images", past + std::chrono::minutes(1));
+    DirectoryIndex checking;
+    ASSERT_TRUE(checking.loadSnapshot(snapshotPath));
+    EXPECT_EQ(checking.lookup(tempDir / "site" / "Images", "older.png"), std::optional<std::string>("Older.png"));
+    EXPECT_EQ(checking.lookup(tempDir / "site" / "Images", "old.png"), std::nullopt);
+
+    createFile(tempDir / "broken.snapshot", "HCCINDEX but not really");
+    EXPECT_FALSE(checking.loadSnapshot(tempDir / "broken.snapshot"));
+    EXPECT_FALSE(checking.loadSnapshot(tempDir / "missing.snapshot"));
+
+}
+
+TEST(IndexSnapshotTest, RejectsSizesThatWrapPastTheFile) {
+    const fs::path path = fs::temp_directory_path() / "html_case_test_forged.snapshot";
+    IndexSnapshot::save({{"/srv/site", 1, {{"Logo.png", IndexSnapshot::EntryType::File}}}}, path);
+    std::string bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Tables that run past the end, with a string size that wraps the total
+    // back round to the file's size
+    uint32_t buckets;
+    uint64_t stringBytes;
+    std::memcpy(&buckets, bytes.data() + 24, sizeof(buckets));
+    std::memcpy(&stringBytes, bytes.data() + 32, sizeof(stringBytes));
+    const uint32_t forgedBuckets = 1u << 30;
+    const uint64_t forgedBytes = stringBytes - uint64_t(forgedBuckets - buckets) * sizeof(uint32_t);
+    std::memcpy(bytes.data() + 24, &forgedBuckets, sizeof(forgedBuckets));
+    std::memcpy(bytes.data() + 32, &forgedBytes, sizeof(forgedBytes));
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+
+    EXPECT_THROW(IndexSnapshot snapshot(path), std::runtime_error);
+    fs::remove(path);
+}
+
+TEST_F(HtmlCaseCorrectorTest, ShardsPartitionTopLevelSubtrees) {
+    const std::vector<std::string> sections = {"Alpha", "Beta", "Gamma", "Delta", "Epsilon", "Zeta"};
+    for (const auto& section : sections) {
+        createFile(tempDir / section / "index.html", "<p></p>");
+        createFile(tempDir / section / "Deep" / "page.html", "<p></p>");
+    }
+    createFile(tempDir / "root.html", "<p></p>");
+
+    constexpr unsigned kShards = 3;
+    std::map<fs::path, unsigned> owner;
+    for (unsigned shard = 0; shard < kShards; ++shard) {
+        HtmlCaseCorrector sharded;
+        sharded.setShard(shard, kShards);
+        for (const auto& page : sharded.findHtmlFiles(tempDir)) {
+            EXPECT_TRUE(owner.emplace(page, shard).second) << page << " is in two shards";
+        }
+    }
+    ASSERT_EQ(owner.size(), sections.size() * 2 + 1);
+    EXPECT_EQ(owner[tempDir / "root.html"], HtmlCaseCorrector::shardOf("", kShards));
+    for (const auto& section : sections) {
+        EXPECT_EQ(owner[tempDir / section / "index.html"], HtmlCaseCorrector::shardOf(section, kShards));
+        EXPECT_EQ(owner[tempDir / section / "Deep" / "page.html"], owner[tempDir / section / "index.html"]);
+    }
+    EXPECT_THROW(corrector.setShard(3, 3), std::runtime_error);
+}
+
+TEST_F(HtmlCaseCorrectorTest, MergedStatsAddUpAcrossShards) {
+    // Counts and times add up; the wall time is the slowest shard's
+    RunStats::Totals first;
+    first.counts[static_cast<size_t>(RunStats::Counter::FilesRewritten)] = 2;
+    first.wallNanoseconds = 3000000000;
+    RunStats::Totals second;
+    second.counts[static_cast<size_t>(RunStats::Counter::FilesRewritten)] = 5;
+    second.calls[static_cast<size_t>(RunStats::Timer::Write)] = 5;
+    second.wallNanoseconds = 1000000000;
+    RunStats::save(second, tempDir / "second.json");
+    first += RunStats::load(tempDir / "second.json");
+    EXPECT_EQ(first.count(RunStats::Counter::FilesRewritten), 7u);
+    EXPECT_EQ(first.calls[static_cast<size_t>(RunStats::Timer::Write)], 5u);
+    EXPECT_EQ(first.wallNanoseconds, 3000000000u);
+}
+
+TEST_F(HtmlCaseCorrectorTest, MergedReportsConcatenateInOrder) {
+    // Blank lines between records are dropped
+    createFile(tempDir / "0.jsonl", "{\"file\":\"a\"}\n");
+    createFile(tempDir / "1.jsonl", "{\"file\":\"b\"}\n\n{\"file\":\"c\"}\n");
+    RewriteReport::merge({tempDir / "0.jsonl", tempDir / "1.jsonl"}, tempDir / "all.jsonl");
+    EXPECT_EQ(corrector.readFile(tempDir / "all.jsonl"),
+              "{\"file\":\"a\"}\n{\"file\":\"b\"}\n{\"file\":\"c\"}\n");
+    EXPECT_THROW(RewriteReport::merge({tempDir / "none.jsonl"}, tempDir / "out.jsonl"), std::runtime_error);
+}
+
+TEST_F(HtmlCaseCorrectorTest, DryRunReportsWithoutWriting) {
+    fs::path report = fs::temp_directory_path() / "html_case_test_report.jsonl";
+    createFile(tempDir / "Images" / "Test.jpg", "");
+    const std::string htmlContent = R"(<a href="x"><img src="images/test.jpg"></a>)";
+    createFile(tempDir / "index.html", htmlContent);
+
+    corrector.setDryRun(true);
+    corrector.setReport(report);
+    corrector.processDirectory(tempDir);
+
+    EXPECT_EQ(corrector.readFile(tempDir / "index.html"), htmlContent);
+    EXPECT_EQ(corrector.readFile(report),
+        "{\"file\":\"" + (tempDir / "index.html").string() + "\",\"offset\":22,"
+        "\"old\":\"images/test.jpg\",\"new\":\"Images/Test.jpg\"}\n");
+
+    fs::remove(report);
+}
+
+TEST_F(HtmlCaseCorrectorTest, RewritesAreAtomicReplacements) {
+    fs::path page = tempDir / "page.html";
+    createFile(page, "old");
+    fs::permissions(page, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+
+    AtomicWriter writer(SyncPolicy::Batch, 2);
+    writer.write(page, "new content");
+    writer.flush();
+
+    EXPECT_EQ(corrector.readFile(page), "new content");
+    EXPECT_EQ(fs::status(page).permissions() & fs::perms::all,
+              fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+
+    // No temporary files are left behind
+    EXPECT_EQ(std::distance(fs::directory_iterator(tempDir), fs::directory_iterator()), 1);
+
+#if defined(__linux__)
+    // Extended attributes move to the replacement, where the filesystem has them
+    if (::setxattr(page.c_str(), "user.html_case_test", "kept", 4, 0) == 0) {
+        writer.write(page, "newer content");
+        char value[8] = {};
+        EXPECT_EQ(::getxattr(page.c_str(), "user.html_case_test", value, sizeof(value)), 4);
+        EXPECT_STREQ(value, "kept");
+    }
+#endif
+}
+
+TEST_F(HtmlCaseCorrectorTest, HandlesEmptyFiles) {
+    fs::path htmlFile = tempDir / "empty.html";
+    createFile(htmlFile, "");
+
+    EXPECT_NO_THROW(corrector.processFile(htmlFile));
+    EXPECT_EQ(corrector.readFile(htmlFile), "");
+}
+
+TEST_F(HtmlCaseCorrectorTest, AsyncReadsMatchSyncReads) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    for (int i = 0; i < 200; ++i) {
+        createFile(tempDir / ("page" + std::to_string(i) + ".html"),
+                   std::string(static_cast<size_t>(i) * 100, ' ') + R"(<img src="images/logo.PNG">)");
+    }
+    createFile(tempDir / "empty.html", "");
+
+    corrector.setIoEngine(IoEngine::Uring);
+    corrector.setJobs(3);
+    corrector.processDirectory(tempDir);
+
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_EQ(corrector.readFile(tempDir / ("page" + std::to_string(i) + ".html")),
+                  std::string(static_cast<size_t>(i) * 100, ' ') + R"(<img src="Images/Logo.png">)");
+    }
+}
+
 TEST_F(HtmlCaseCorrectorTest, HandlesPermissionErrors) {
     // Create test file
     fs::path testFile = tempDir / "test.html";
@@ -152,6 +975,129 @@ TEST_F(HtmlCaseCorrectorTest, HandlesPermissionErrors) {
     fs::permissions(testFile, fs::perms::owner_all);
 }
 
+TEST_F(HtmlCaseCorrectorTest, WindowedScanMatchesWholeDocument) {
+    const std::vector<std::string> documents = {
+        "<p>text</p><img src='a.png' alt=x><a href=\"b/c.html\">link</a>",
+        "<!-- <img src='hidden.png'> --><img src=after.png>",
+        "<script>if (a</b) document.write('<img src=\"x.png\">')</script><img src='y.png'>",
+        "<style>body { background: url(bg.png) }</style><link rel=stylesheet href=s.css>",
+        "<!DOCTYPE html><html><body><img\n  data-x=1\n  src = 'spaced.png'></body></html>",
+    };
+    auto whole = [](const std::string& html) {
+        std::vector<std::pair<size_t, size_t>> spans;
+        EXPECT_TRUE(scanAttributes(html, [&](const AttributeSpan& attr) {
+            spans.emplace_back(attr.valueOffset, attr.valueLength);
+        }));
+        return spans;
+    };
+    // Windows of `size` bytes, grown whenever one token fills a window
+    auto windowed = [](const std::string& html, size_t size) {
+        std::vector<std::pair<size_t, size_t>> spans;
+        ScanState state;
+        size_t base = 0;
+        while (base < html.size()) {
+            const bool final = base + size >= html.size();
+            const std::string_view window = std::string_view(html).substr(base, size);
+            const size_t consumed = scanAttributeWindow(window, final, state, [&](const AttributeSpan& attr) {
+                spans.emplace_back(base + attr.valueOffset, attr.valueLength);
+            });
+            if (consumed == 0 && !final) {
+                size *= 2;
+            }
+            base += consumed;
+        }
+        return spans;
+    };
+
+    for (const auto& html : documents) {
+        for (size_t size : {1, 5, 7, 16, 1000}) {
+            EXPECT_EQ(windowed(html, size), whole(html)) << html << " in windows of " << size;
+        }
+    }
+
+    // Without a parser to fall back to, a value needing decoding is skipped
+    ScanState state;
+    size_t reported = 0;
+    EXPECT_EQ(scanAttributeWindow("<a href='x?a&amp;b'><img src=y.png>", true, state,
+                                  [&](const AttributeSpan&) { ++reported; }), 35u);
+    EXPECT_EQ(reported, 1u);
+}
+
+TEST_F(HtmlCaseCorrectorTest, StreamsLargePagesInWindows) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    // References on both sides of window boundaries, some of them cut in two
+    std::string page = "<html><body>";
+    std::string expected = page;
+    const std::string filler(4093, 'x');
+    for (int i = 0; i < 1000; ++i) {
+        page += "<p>" + filler + "</p><img src=\"images/logo.png\">";
+        expected += "<p>" + filler + "</p><img src=\"Images/Logo.png\">";
+    }
+    page += "</body></html>";
+    expected += "</body></html>";
+    ASSERT_GT(page.size(), 3 * HtmlCaseCorrector::kStreamWindowBytes);
+    createFile(tempDir / "big.html", page);
+    createFile(tempDir / "small.html", R"(<img src="images/logo.png">)");
+
+    corrector.setStreamingThreshold(page.size());
+    corrector.setReport(tempDir / "report.jsonl");
+    corrector.setStats(true);
+    corrector.processDirectory(tempDir);
+
+    EXPECT_EQ(corrector.readFile(tempDir / "big.html"), expected);
+    EXPECT_EQ(corrector.readFile(tempDir / "small.html"), R"(<img src="Images/Logo.png">)");
+    EXPECT_EQ(corrector.stats()->totals().count(RunStats::Counter::ReferencesCorrected), 1001u);
+    // Reported offsets are into the whole page, not the window
+    const std::string report = corrector.readFile(tempDir / "report.jsonl");
+    EXPECT_THAT(report, testing::HasSubstr("\"offset\":" + std::to_string(page.rfind("images/logo.png"))));
+
+    // A page without anything to fix is never rewritten
+    createFile(tempDir / "plain.html", std::string(page.size(), 'p'));
+    const auto before = fs::last_write_time(tempDir / "plain.html");
+    fs::remove(tempDir / "big.html");
+    corrector.processDirectory(tempDir);
+    EXPECT_EQ(fs::last_write_time(tempDir / "plain.html"), before);
+}
+
+TEST_F(HtmlCaseCorrectorTest, CleanPagesAreNeitherCopiedNorReread) {
+    createFile(tempDir / "Images" / "Logo.png", "");
+    const fs::path page = tempDir / "index.html";
+
+    std::string corrected = "untouched";
+    EXPECT_EQ(corrector.correctFileReferences(R"(<img src="Images/Logo.png">)", page, corrected), 0u);
+    EXPECT_EQ(corrected, "untouched");
+    EXPECT_EQ(corrector.correctFileReferences(R"(<img src="images/logo.png"><a href="IMAGES/LOGO.PNG">)",
+                                              page, corrected), 2u);
+    EXPECT_EQ(corrected, R"(<img src="Images/Logo.png"><a href="Images/Logo.png">)");
+
+    // The manifest hashes pages left alone from what was read, streamed or
+    // not; touching them afterwards must still match that hash
+    fs::path manifest = fs::temp_directory_path() / "html_case_test_clean_manifest";
+    const std::string large = "<p>" + std::string(2 * HtmlCaseCorrector::kStreamWindowBytes, 'x') +
+                              R"(</p><img src="Images/Logo.png">)";
+    createFile(page, R"(<img src="Images/Logo.png">)");
+    createFile(tempDir / "large.html", large);
+    {
+        HtmlCaseCorrector first;
+        first.setManifest(manifest);
+        first.setStreamingThreshold(large.size());
+        first.processDirectory(tempDir);
+    }
+    for (const fs::path& touched : {page, tempDir / "large.html"}) {
+        fs::last_write_time(touched, fs::last_write_time(touched) + std::chrono::minutes(1));
+    }
+    {
+        HtmlCaseCorrector second;
+        second.setManifest(manifest);
+        second.setStreamingThreshold(large.size());
+        second.processDirectory(tempDir);
+        EXPECT_EQ(second.unchangedFiles(), 2u);
+    }
+    EXPECT_EQ(corrector.readFile(tempDir / "large.html"), large);
+
+    fs::remove(manifest);
+}
+
 // Parameterized test for different HTML patterns
 class HtmlPatternTest : public HtmlCaseCorrectorTest,
                        public testing::WithParamInterface<std::tuple<std::string, std::string>> {
@@ -184,6 +1130,46 @@ INSTANTIATE_TEST_SUITE_P(
     )
 );
 
+// The lexer engine must produce byte-identical output to the Gumbo engine
+class EngineEquivalenceTest : public HtmlCaseCorrectorTest,
+                              public testing::WithParamInterface<std::string> {
+};
+
+TEST_P(EngineEquivalenceTest, LexerMatchesGumbo) {
+    createFile(tempDir / "Test.jpg", "");
+    createFile(tempDir / "SubDir" / "Page.html", "");
+
+    fs::path gumboFile = tempDir / "gumbo.html";
+    fs::path lexerFile = tempDir / "lexer.html";
+    createFile(gumboFile, GetParam());
+    createFile(lexerFile, GetParam());
+
+    corrector.setEngine(ParseEngine::Gumbo);
+    corrector.processFile(gumboFile);
+    corrector.setEngine(ParseEngine::Lexer);
+    corrector.processFile(lexerFile);
+
+    EXPECT_EQ(corrector.readFile(lexerFile), corrector.readFile(gumboFile));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    HtmlPatterns,
+    EngineEquivalenceTest,
+    testing::Values(
+        "<img src='test.jpg'>",
+        "<img SRC='TEST.JPG'>",
+        "<a href='subdir/page.html'>",
+        "<img src='test.jpg' href='page.html'>",
+        "<img src=test.jpg alt=x><a href=\"SUBDIR/page.HTML\">Link</a>",
+        "<img src='test.jpg' src='TEST.jpg'>",
+        "<!-- <img src='test.jpg'> --><p>test.jpg</p>",
+        "<script>document.write('<img src=\"test.jpg\">')</script><img src='test.jpg'>",
+        "</a href='test.jpg'><img src='test.jpg'>",
+        "<img src='test.jpg",
+        "<a href='subdir/page.html?a=1&amp;b=2'>"
+    )
+);
+
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
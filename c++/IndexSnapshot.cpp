@@ -0,0 +1,321 @@
+#include "IndexSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "AtomicWriter.h"
+#include "CaseFolding.h"
+
+namespace {
+constexpr char kMagic[8] = {'H', 'C', 'C', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kByteOrder = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;  // kByteOrder as the writer stored it
+    uint32_t listings;
+    uint32_t entries;
+    uint32_t buckets;
+    uint32_t reserved;
+    uint64_t stringBytes;
+};
+
+// FNV-1a of the folded name, seeded by the listing it belongs to
+uint64_t hashKey(uint32_t listing, std::string_view folded) {
+    uint64_t hash = 14695981039346656037ull ^ (static_cast<uint64_t>(listing) * 0x9E3779B97F4A7C15ull);
+    for (unsigned char c : folded) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename T>
+void append(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Records are copied out rather than cast in place, so a file read into an
+// unaligned buffer works as well as a mapping
+template <typename T>
+T readAt(const char* data, size_t offset) {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+[[noreturn]] void corrupt(const fs::path& path) {
+    throw std::runtime_error("Not a valid index snapshot: " + path.string());
+}
+}
+
+struct IndexSnapshot::ListingRecord {
+    uint32_t path;
+    uint32_t pathLength;
+    uint32_t firstEntry;
+    uint32_t entryCount;
+    int64_t mtime;
+};
+
+struct IndexSnapshot::EntryRecord {
+    uint32_t name;
+    uint32_t folded;
+    uint16_t nameLength;
+    uint16_t foldedLength;
+    uint8_t type;
+    uint8_t padding[3];
+};
+
+// index_snapshot.cpp
+IndexSnapshot::IndexSnapshot(const fs::path& path)
+    : file_(path) {
+    if (file_.size() < sizeof(Header)) {
+        corrupt(path);
+    }
+    const Header header = readAt<Header>(file_.data(), 0);
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.byteOrder != kByteOrder) {
+        corrupt(path);
+    }
+    if (header.buckets & (header.buckets - 1)) {
+        corrupt(path);
+    }
+
+    listings_ = header.listings;
+    entries_ = header.entries;
+    buckets_ = header.buckets;
+    listingsAt_ = sizeof(Header);
+    entriesAt_ = listingsAt_ + size_t(listings_) * sizeof(ListingRecord);
+    bucketsAt_ = entriesAt_ + size_t(entries_) * sizeof(EntryRecord);
+    stringsAt_ = bucketsAt_ + size_t(buckets_) * sizeof(uint32_t);
+    stringBytes_ = static_cast<size_t>(header.stringBytes);
+    // Compared by subtraction: a forged stringBytes could wrap the sum
+    if (stringsAt_ > file_.size() || stringBytes_ != file_.size() - stringsAt_) {
+        corrupt(path);
+    }
+
+    // A damaged file is rejected here rather than read out of bounds later
+    auto inStrings = [this](uint32_t offset, uint32_t length) {
+        return size_t(offset) + length <= stringBytes_;
+    };
+    for (uint32_t i = 0; i < listings_; ++i) {
+        const ListingRecord listing = listingAt(i);
+        if (!inStrings(listing.path, listing.pathLength) ||
+            uint64_t(listing.firstEntry) + listing.entryCount > entries_) {
+            corrupt(path);
+        }
+    }
+    for (uint32_t i = 0; i < entries_; ++i) {
+        const EntryRecord entry = entryAt(i);
+        if (!inStrings(entry.name, entry.nameLength) || !inStrings(entry.folded, entry.foldedLength) ||
+            entry.type > static_cast<uint8_t>(EntryType::Symlink)) {
+            corrupt(path);
+        }
+    }
+    // Every entry in exactly one bucket, and some bucket empty so that probing ends
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < buckets_; ++i) {
+        const uint32_t slot = readAt<uint32_t>(file_.data(), bucketsAt_ + size_t(i) * sizeof(uint32_t));
+        if (slot > entries_) {
+            corrupt(path);
+        }
+        used += slot != 0;
+    }
+    if (used != entries_ || (entries_ > 0 && used >= buckets_)) {
+        corrupt(path);
+    }
+}
+
+void IndexSnapshot::save(std::vector<Listing> listings, const fs::path& path) {
+    std::stable_sort(listings.begin(), listings.end(),
+                     [](const Listing& a, const Listing& b) { return a.directory < b.directory; });
+    listings.erase(std::unique(listings.begin(), listings.end(),
+                               [](const Listing& a, const Listing& b) { return a.directory == b.directory; }),
+                   listings.end());
+
+    struct Folded {
+        const Entry* entry;
+        std::string folded;
+    };
+    std::vector<std::vector<Folded>> folded(listings.size());
+    std::vector<std::string_view> strings;
+    size_t entryCount = 0;
+    for (size_t i = 0; i < listings.size(); ++i) {
+        auto& entries = folded[i];
+        for (const auto& entry : listings[i].entries) {
+            std::string key = foldCase(entry.name);
+            if (entry.name.size() <= std::numeric_limits<uint16_t>::max() &&
+                key.size() <= std::numeric_limits<uint16_t>::max()) {
+                entries.push_back(Folded{&entry, std::move(key)});
+            }
+        }
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Folded& a, const Folded& b) { return a.folded < b.folded; });
+        entries.erase(std::unique(entries.begin(), entries.end(),
+                                  [](const Folded& a, const Folded& b) { return a.folded == b.folded; }),
+                      entries.end());
+        entryCount += entries.size();
+
+        strings.push_back(listings[i].directory);
+        for (const auto& entry : entries) {
+            strings.push_back(entry.entry->name);
+            strings.push_back(entry.folded);
+        }
+    }
+
+    // Sorted and deduplicated: a name that is already lowercase shares its
+    // bytes with its folded form, and repeated names are stored once
+    std::sort(strings.begin(), strings.end());
+    strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+    std::vector<uint64_t> offsets(strings.size());
+    uint64_t stringBytes = 0;
+    for (size_t i = 0; i < strings.size(); ++i) {
+        offsets[i] = stringBytes;
+        stringBytes += strings[i].size();
+    }
+    if (stringBytes > std::numeric_limits<uint32_t>::max() ||
+        entryCount >= std::numeric_limits<uint32_t>::max() / 2) {
+        throw std::runtime_error("Directory index too large for a snapshot: " + path.string());
+    }
+    auto offsetOf = [&strings, &offsets](std::string_view text) {
+        return static_cast<uint32_t>(offsets[std::lower_bound(strings.begin(), strings.end(), text) -
+                                             strings.begin()]);
+    };
+
+    uint32_t buckets = 0;
+    if (entryCount > 0) {
+        buckets = 1;
+        while (buckets < entryCount * 2) {
+            buckets <<= 1;
+        }
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.listings = static_cast<uint32_t>(listings.size());
+    header.entries = static_cast<uint32_t>(entryCount);
+    header.buckets = buckets;
+    header.stringBytes = stringBytes;
+
+    std::string out;
+    out.reserve(sizeof(Header) + listings.size() * sizeof(ListingRecord) + entryCount * sizeof(EntryRecord) +
+                size_t(buckets) * sizeof(uint32_t) + stringBytes);
+    append(out, header);
+
+    uint32_t firstEntry = 0;
+    for (size_t i = 0; i < listings.size(); ++i) {
+        ListingRecord record{};
+        record.path = offsetOf(listings[i].directory);
+        record.pathLength = static_cast<uint32_t>(listings[i].directory.size());
+        record.firstEntry = firstEntry;
+        record.entryCount = static_cast<uint32_t>(folded[i].size());
+        record.mtime = listings[i].mtime;
+        append(out, record);
+        firstEntry += record.entryCount;
+    }
+
+    std::vector<uint32_t> table(buckets, 0);
+    uint32_t entryIndex = 0;
+    for (size_t i = 0; i < listings.size(); ++i) {
+        for (const auto& entry : folded[i]) {
+            EntryRecord record{};
+            record.name = offsetOf(entry.entry->name);
+            record.folded = offsetOf(entry.folded);
+            record.nameLength = static_cast<uint16_t>(entry.entry->name.size());
+            record.foldedLength = static_cast<uint16_t>(entry.folded.size());
+            record.type = static_cast<uint8_t>(entry.entry->type);
+            append(out, record);
+
+            size_t bucket = hashKey(static_cast<uint32_t>(i), entry.folded) & (buckets - 1);
+            while (table[bucket] != 0) {
+                bucket = (bucket + 1) & (buckets - 1);
+            }
+            table[bucket] = ++entryIndex;  // 0 marks an empty bucket
+        }
+    }
+    for (uint32_t bucket : table) {
+        append(out, bucket);
+    }
+    for (std::string_view text : strings) {
+        out.append(text);
+    }
+
+    AtomicWriter writer;
+    writer.write(path, out);
+}
+
+uint32_t IndexSnapshot::find(std::string_view directory) const {
+    uint32_t low = 0;
+    uint32_t high = listings_;
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        const std::string_view candidate = this->directory(middle);
+        if (candidate == directory) {
+            return middle;
+        }
+        if (candidate < directory) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return kNotFound;
+}
+
+std::string_view IndexSnapshot::directory(uint32_t listing) const {
+    const ListingRecord record = listingAt(listing);
+    return string(record.path, record.pathLength);
+}
+
+int64_t IndexSnapshot::mtime(uint32_t listing) const {
+    return listingAt(listing).mtime;
+}
+
+std::optional<std::string_view> IndexSnapshot::lookup(uint32_t listing, std::string_view folded) const {
+    if (buckets_ == 0) {
+        return std::nullopt;
+    }
+    const ListingRecord record = listingAt(listing);
+    for (size_t bucket = hashKey(listing, folded) & (buckets_ - 1);;
+         bucket = (bucket + 1) & (buckets_ - 1)) {
+        const uint32_t slot = readAt<uint32_t>(file_.data(), bucketsAt_ + bucket * sizeof(uint32_t));
+        if (slot == 0) {
+            return std::nullopt;
+        }
+        const uint32_t entry = slot - 1;
+        if (entry < record.firstEntry || entry - record.firstEntry >= record.entryCount) {
+            continue;  // another listing's entry
+        }
+        const EntryRecord candidate = entryAt(entry);
+        if (string(candidate.folded, candidate.foldedLength) == folded) {
+            return string(candidate.name, candidate.nameLength);
+        }
+    }
+}
+
+void IndexSnapshot::forEach(uint32_t listing, const Visit& visit) const {
+    const ListingRecord record = listingAt(listing);
+    for (uint32_t i = 0; i < record.entryCount; ++i) {
+        const EntryRecord entry = entryAt(record.firstEntry + i);
+        visit(string(entry.name, entry.nameLength), string(entry.folded, entry.foldedLength),
+              static_cast<EntryType>(entry.type));
+    }
+}
+
+IndexSnapshot::ListingRecord IndexSnapshot::listingAt(uint32_t listing) const {
+    return readAt<ListingRecord>(file_.data(), listingsAt_ + size_t(listing) * sizeof(ListingRecord));
+}
+
+IndexSnapshot::EntryRecord IndexSnapshot::entryAt(uint32_t entry) const {
+    return readAt<EntryRecord>(file_.data(), entriesAt_ + size_t(entry) * sizeof(EntryRecord));
+}
+
+std::string_view IndexSnapshot::string(uint32_t offset, uint32_t length) const {
+    return std::string_view(file_.data() + stringsAt_ + offset, length);
+}
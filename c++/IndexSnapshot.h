@@ -0,0 +1,96 @@
+// index_snapshot.h
+#ifndef INDEX_SNAPSHOT_H
+#define INDEX_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace fs = std::filesystem;
+
+// Directory listings saved by one run for the next, in a file that is used
+// where it lies: loading maps it and makes one bounds-checking pass over its
+// records, and every lookup then reads the mapping directly. Nothing is
+// parsed into memory or allocated per directory; finding a listing is a
+// binary search and finding a name in it one hash probe sequence.
+//
+// Layout, in native byte order (a snapshot from another architecture is
+// rejected): a header; the listings sorted by directory path, each with its
+// mtime and a range of entries; the entries, sorted by folded name within
+// their listing; an open-addressing table from (listing, folded name) to
+// entry; and a sorted, deduplicated string table that every path and name
+// points into.
+class IndexSnapshot {
+public:
+    enum class EntryType : uint8_t {
+        Other,
+        File,       // regular file
+        Directory,
+        Symlink     // to whatever; only its target's type says
+    };
+
+    struct Entry {
+        std::string name;
+        EntryType type = EntryType::Other;
+    };
+
+    struct Listing {
+        std::string directory;  // absolute
+        int64_t mtime = 0;
+        std::vector<Entry> entries;
+    };
+
+    using Visit = std::function<void(std::string_view name, std::string_view folded, EntryType type)>;
+
+    // Map the snapshot at `path`; throws std::runtime_error if it can't be
+    // read or isn't a snapshot this version wrote
+    explicit IndexSnapshot(const fs::path& path);
+
+    // Write `listings` to `path`, replacing it atomically (throws
+    // std::runtime_error). Names that fold to one already in the same
+    // listing are dropped.
+    static void save(std::vector<Listing> listings, const fs::path& path);
+
+    static constexpr uint32_t kNotFound = UINT32_MAX;
+
+    size_t size() const { return listings_; }
+
+    // Listing of `directory` (absolute, as saved), or kNotFound
+    uint32_t find(std::string_view directory) const;
+
+    std::string_view directory(uint32_t listing) const;
+    int64_t mtime(uint32_t listing) const;
+
+    // Actual name of the entry of `listing` whose folded name is `folded`
+    std::optional<std::string_view> lookup(uint32_t listing, std::string_view folded) const;
+
+    // Call `visit` for every entry of `listing`, in folded-name order
+    void forEach(uint32_t listing, const Visit& visit) const;
+
+private:
+    struct ListingRecord;
+    struct EntryRecord;
+
+    ListingRecord listingAt(uint32_t listing) const;
+    EntryRecord entryAt(uint32_t entry) const;
+    std::string_view string(uint32_t offset, uint32_t length) const;
+
+    MappedFile file_;
+    uint32_t listings_ = 0;
+    uint32_t entries_ = 0;
+    uint32_t buckets_ = 0;  // a power of two, or 0 without entries
+    size_t listingsAt_ = 0;
+    size_t entriesAt_ = 0;
+    size_t bucketsAt_ = 0;
+    size_t stringsAt_ = 0;
+    size_t stringBytes_ = 0;
+};
+
+#endif // INDEX_SNAPSHOT_H
@@ -0,0 +1,153 @@
+#include "IoUring.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#define HTML_CASE_CORRECTOR_HAVE_IO_URING 1
+#endif
+
+// io_uring.cpp
+#ifdef HTML_CASE_CORRECTOR_HAVE_IO_URING
+
+std::unique_ptr<IoUring> IoUring::create(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<IoUring> ring(new IoUring());
+    ring->fd_ = fd;
+
+    ring->sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        ring->sqRingSize_ = ring->cqRingSize_ = std::max(ring->sqRingSize_, ring->cqRingSize_);
+    }
+
+    void* sq = ::mmap(nullptr, ring->sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        return nullptr;
+    }
+    ring->sqRing_ = sq;
+
+    void* cq = sq;
+    if (!singleMap) {
+        cq = ::mmap(nullptr, ring->cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            return nullptr;
+        }
+    }
+    ring->cqRing_ = cq;
+
+    ring->sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, ring->sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return nullptr;
+    }
+    ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sqBase = static_cast<char*>(sq);
+    ring->sqHead_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+    ring->sqTail_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+    ring->sqMask_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+    ring->sqArray_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+    ring->sqEntries_ = params.sq_entries;
+
+    char* cqBase = static_cast<char*>(cq);
+    ring->cqHead_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+    ring->cqTail_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+    ring->cqMask_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+    ring->cqes_ = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+    return ring;
+}
+
+IoUring::~IoUring() {
+    if (sqes_) {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ && cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_) {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool IoUring::prepareReadv(int fd, const iovec* iov, uint64_t offset, uint64_t userData) {
+    unsigned tail = *sqTail_;
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (tail - head >= sqEntries_) {
+        return false;
+    }
+
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = userData;
+
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++toSubmit_;
+    return true;
+}
+
+bool IoUring::waitCompletion(uint64_t& userData, int& result) {
+    for (;;) {
+        unsigned head = *cqHead_;
+        if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+            userData = cqe.user_data;
+            result = cqe.res;
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        int submitted = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, toSubmit_, 1u,
+                                                   IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (submitted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        toSubmit_ -= static_cast<unsigned>(submitted);
+    }
+}
+
+#else
+
+std::unique_ptr<IoUring> IoUring::create(unsigned) {
+    return nullptr;
+}
+
+IoUring::~IoUring() = default;
+
+bool IoUring::prepareReadv(int, const iovec*, uint64_t, uint64_t) {
+    return false;
+}
+
+bool IoUring::waitCompletion(uint64_t&, int&) {
+    return false;
+}
+
+#endif // HTML_CASE_CORRECTOR_HAVE_IO_URING
@@ -0,0 +1,57 @@
+// io_uring.h
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct iovec;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Minimal io_uring binding over the raw syscalls, so no liburing is needed.
+// Only what the async reader uses: queue vectored reads, submit, and reap
+// completions. Not thread-safe; one thread owns the ring.
+class IoUring {
+public:
+    // nullptr when the platform or kernel has no usable io_uring
+    static std::unique_ptr<IoUring> create(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Queue a readv; `iov` must stay valid until it completes. Returns false
+    // if the submission queue is full.
+    bool prepareReadv(int fd, const iovec* iov, uint64_t offset, uint64_t userData);
+
+    // Hand queued entries to the kernel and wait for at least one completion.
+    // `result` is the byte count or a negative errno. Returns false on error.
+    bool waitCompletion(uint64_t& userData, int& result);
+
+private:
+    IoUring() = default;
+
+    int fd_ = -1;
+    unsigned toSubmit_ = 0;
+
+    void* sqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqMask_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqEntries_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+
+    void* cqRing_ = nullptr;
+    size_t cqRingSize_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned* cqMask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif // IO_URING_H
@@ -0,0 +1,170 @@
+#include "Manifest.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "AtomicWriter.h"
+
+namespace {
+constexpr const char* kManifestHeader = "html-case-corrector-manifest 1";
+
+int64_t toTicks(fs::file_time_type time) {
+    return static_cast<int64_t>(time.time_since_epoch().count());
+}
+}
+
+// manifest.cpp
+void Manifest::load(const fs::path& path) {
+    previous_.clear();
+    previousDirectories_.clear();
+
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    if (!file || !std::getline(file, line) || line != kManifestHeader) {
+        return;
+    }
+
+    // Directory lines come first; files refer to them by position
+    std::vector<std::string> directories;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        char kind = 0;
+        fields >> kind;
+
+        if (kind == 'D') {
+            int64_t mtime = 0;
+            std::string directory;
+            if (fields >> mtime && fields.get() == ' ' && std::getline(fields, directory)) {
+                previousDirectories_[directory] = mtime;
+                directories.push_back(std::move(directory));
+            }
+        } else if (kind == 'F') {
+            FileEntry entry;
+            size_t count = 0;
+            if (!(fields >> entry.size >> entry.mtime >> std::hex >> entry.hash >> std::dec >> count)) {
+                continue;
+            }
+            bool valid = true;
+            for (size_t i = 0; i < count && valid; ++i) {
+                size_t id = 0;
+                valid = static_cast<bool>(fields >> id) && id < directories.size();
+                if (valid) {
+                    entry.dependencies.push_back(directories[id]);
+                }
+            }
+            std::string htmlFile;
+            if (valid && fields.get() == ' ' && std::getline(fields, htmlFile)) {
+                previous_[htmlFile] = std::move(entry);
+            }
+        }
+    }
+}
+
+void Manifest::save(const fs::path& path, const ListedMtime& listedMtime) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::ostringstream file;
+    file << kManifestHeader << '\n';
+
+    // A directory's mtime has to predate the listing the pages were
+    // checked against, or a change made in between would go unnoticed
+    std::unordered_map<std::string, size_t> ids;
+    for (const auto& [htmlFile, entry] : current_) {
+        for (const auto& directory : entry.dependencies) {
+            if (ids.emplace(directory, ids.size()).second) {
+                std::optional<int64_t> mtime = listedMtime ? listedMtime(directory) : std::nullopt;
+                if (!mtime) {
+                    auto recorded = previousDirectories_.find(directory);
+                    mtime = recorded != previousDirectories_.end() ? recorded->second : -1;
+                }
+                file << "D " << *mtime << ' ' << directory << '\n';
+            }
+        }
+    }
+    for (const auto& [htmlFile, entry] : current_) {
+        file << "F " << entry.size << ' ' << entry.mtime << ' '
+             << std::hex << entry.hash << std::dec << ' ' << entry.dependencies.size();
+        for (const auto& directory : entry.dependencies) {
+            file << ' ' << ids[directory];
+        }
+        file << ' ' << htmlFile << '\n';
+    }
+
+    // Synced before it replaces the old one, so a crash leaves one whole
+    // manifest or the other; concurrent saves each write their own temp file
+    AtomicWriter writer(SyncPolicy::File);
+    writer.write(path, file.str());
+}
+
+const Manifest::FileEntry* Manifest::previous(const fs::path& htmlFile) const {
+    auto it = previous_.find(htmlFile.string());
+    return it != previous_.end() ? &it->second : nullptr;
+}
+
+bool Manifest::dependenciesUnchanged(const FileEntry& entry) {
+    for (const auto& directory : entry.dependencies) {
+        auto recorded = previousDirectories_.find(directory);
+        if (recorded == previousDirectories_.end() || recorded->second != directoryMtime(directory)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Manifest::record(const fs::path& htmlFile, FileEntry entry) {
+    std::string path = htmlFile.string();
+    if (path.find('\n') != std::string::npos) {
+        return;  // not representable in the line format; simply never skipped
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_[std::move(path)] = std::move(entry);
+}
+
+void Manifest::carryOver() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [htmlFile, entry] : previous_) {
+        current_.emplace(htmlFile, entry);
+    }
+}
+
+void Manifest::forEachPrevious(const std::function<void(const std::string&, const FileEntry&)>& visit) const {
+    for (const auto& [htmlFile, entry] : previous_) {
+        visit(htmlFile, entry);
+    }
+}
+
+size_t Manifest::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_.size();
+}
+
+void Manifest::stamp(const fs::path& file, uintmax_t& size, int64_t& mtime) {
+    size = fs::file_size(file);
+    mtime = toTicks(fs::last_write_time(file));
+}
+
+uint64_t Manifest::hashContent(std::string_view content, uint64_t hash) {
+    for (unsigned char c : content) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+int64_t Manifest::directoryMtime(const std::string& directory) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto cached = directoryMtimes_.find(directory);
+        if (cached != directoryMtimes_.end()) {
+            return cached->second;
+        }
+    }
+
+    std::error_code ec;
+    auto time = fs::last_write_time(directory, ec);
+    int64_t mtime = ec ? -1 : toTicks(time);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directoryMtimes_.emplace(directory, mtime).first->second;
+}
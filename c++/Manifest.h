@@ -0,0 +1,81 @@
+// manifest.h
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Record of a previous run used to skip pages that can't have changed: each
+// HTML file maps to its size, mtime and content hash plus the directories
+// whose listings its references were resolved against. A page is up to date
+// when its own stamp and every dependency's mtime still match.
+class Manifest {
+public:
+    struct FileEntry {
+        uintmax_t size = 0;
+        int64_t mtime = 0;
+        uint64_t hash = 0;
+        std::vector<std::string> dependencies;
+    };
+
+    // Replace the contents with the manifest at `path`. A missing or
+    // unreadable manifest leaves it empty; that just means a full run.
+    void load(const fs::path& path);
+
+    // Mtime a directory was listed at during this run, -1 if its listing
+    // can't be vouched for, or nullopt if it wasn't listed
+    using ListedMtime = std::function<std::optional<int64_t>(const std::string& directory)>;
+
+    // Write the entries recorded during this run (throws std::runtime_error).
+    // Dependencies get the mtime `listedMtime` reports, or else the one the
+    // loaded manifest recorded and this run checked.
+    void save(const fs::path& path, const ListedMtime& listedMtime = {}) const;
+
+    // Entry from the loaded manifest, or nullptr
+    const FileEntry* previous(const fs::path& htmlFile) const;
+
+    // Do all of `entry`'s dependency directories still have their recorded mtimes?
+    bool dependenciesUnchanged(const FileEntry& entry);
+
+    // Store the state of `htmlFile` after this run
+    void record(const fs::path& htmlFile, FileEntry entry);
+
+    // Keep every loaded entry this run didn't record, for runs that only
+    // visit some of the pages
+    void carryOver();
+
+    // Call `visit` for every entry of the loaded manifest
+    void forEachPrevious(const std::function<void(const std::string& htmlFile, const FileEntry&)>& visit) const;
+
+    size_t size() const;
+
+    // Current size and mtime of a file; throws fs::filesystem_error
+    static void stamp(const fs::path& file, uintmax_t& size, int64_t& mtime);
+
+    // FNV-1a, enough to tell a touched file from an edited one. Pass the
+    // hash so far to continue it over content that arrives in pieces.
+    static constexpr uint64_t kHashSeed = 14695981039346656037ull;
+    static uint64_t hashContent(std::string_view content, uint64_t hash = kHashSeed);
+
+private:
+    // Directory mtime as of its first query in this run (-1 if it's gone)
+    int64_t directoryMtime(const std::string& directory);
+
+    std::unordered_map<std::string, FileEntry> previous_;
+    std::unordered_map<std::string, int64_t> previousDirectories_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, FileEntry> current_;
+    std::unordered_map<std::string, int64_t> directoryMtimes_;
+};
+
+#endif // MANIFEST_H
@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HTML_CASE_CORRECTOR_HAVE_MMAP 1
+#endif
+
+// mapped_file.cpp
+MappedFile::MappedFile(const fs::path& path, Mode mode) {
+#ifdef HTML_CASE_CORRECTOR_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path.string());
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat file: " + path.string());
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (mode == Mode::Read) {
+        // Read what is there now; a file cut short meanwhile just reads shorter
+        buffer_.resize(size_);
+        size_t have = 0;
+        while (have < buffer_.size()) {
+            ssize_t got = ::pread(fd, buffer_.data() + have, buffer_.size() - have, static_cast<off_t>(have));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                ::close(fd);
+                throw std::runtime_error("Cannot read file: " + path.string());
+            }
+            if (got == 0) {
+                break;
+            }
+            have += static_cast<size_t>(got);
+        }
+        ::close(fd);
+        buffer_.resize(have);
+        data_ = buffer_.data();
+        size_ = have;
+        return;
+    }
+    if (size_ == 0) {
+        // mmap rejects empty ranges; an empty view needs no storage
+        ::close(fd);
+        data_ = buffer_.data();
+        return;
+    }
+
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map file: " + path.string());
+    }
+    ::madvise(addr, size_, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char*>(addr);
+    mapped_ = true;
+#else
+    (void)mode;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open file: " + path.string());
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef HTML_CASE_CORRECTOR_HAVE_MMAP
+    if (mapped_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
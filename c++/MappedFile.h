@@ -0,0 +1,40 @@
+// mapped_file.h
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Read-only view of a whole file. Uses mmap where available so the contents
+// are never copied into a std::string; elsewhere the file is read into an
+// owned buffer.
+class MappedFile {
+public:
+    enum class Mode {
+        Map,  // where available
+        Read  // always into the buffer; for files other programs may truncate,
+              // which would fault (SIGBUS) on a mapping of them
+    };
+
+    // Throws std::runtime_error if the file can't be opened, mapped or read
+    explicit MappedFile(const fs::path& path, Mode mode = Mode::Map);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return std::string_view(data_, size_); }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::string buffer_;  // fallback storage when the file isn't mapped
+};
+
+#endif // MAPPED_FILE_H
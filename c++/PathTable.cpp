@@ -0,0 +1,232 @@
+#include "PathTable.h"
+
+#include <mutex>
+
+namespace {
+constexpr std::string_view kRootName = "/";
+}
+
+// path_table.cpp
+PathTable::PathTable() {
+    clear();
+}
+
+PathTable::Id PathTable::child(Id parent, std::string_view name) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = children_.find(ChildKey{parent, name});
+        if (it != children_.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    return childLocked(parent, name);
+}
+
+PathTable::Id PathTable::childLocked(Id parent, std::string_view name) {
+    auto it = children_.find(ChildKey{parent, name});
+    if (it != children_.end()) {
+        return it->second;
+    }
+
+    std::string_view interned = internNameLocked(name);
+    // The node is complete before the lock is released, and its ID can only
+    // be learned after that, so readers of nodes need no lock
+    const Id id = size_++;
+    children_.emplace(ChildKey{parent, interned}, id);
+    nodes_.at(id) = Node{parent, nodes_[parent].depth + 1, interned, id};
+
+    // Lexical form: "." and empty components vanish, ".." cancels the
+    // component before it unless there is none left to cancel
+    const Id base = nodes_[parent].normalized;
+    Id normalized = id;
+    if (name.empty() || name == ".") {
+        normalized = base;
+    } else if (name == "..") {
+        if (base != kEmpty && nodes_[base].name != "..") {
+            normalized = nodes_[base].name == kRootName && nodes_[base].parent == kEmpty ? base : nodes_[base].parent;
+        } else if (base != parent) {
+            normalized = childLocked(base, name);
+        }
+    } else if (base != parent) {
+        normalized = childLocked(base, name);
+    }
+    nodes_[id].normalized = normalized;
+    return id;
+}
+
+PathTable::Id PathTable::intern(const fs::path& path) {
+    Id id = kEmpty;
+    for (const auto& component : path) {
+        id = child(id, component.string());
+    }
+    return id;
+}
+
+PathTable::Id PathTable::intern(Id base, std::string_view reference) {
+    Id id = base;
+    size_t start = 0;
+    if (!reference.empty() && reference.front() == '/') {
+        id = child(kEmpty, kRootName);
+        start = reference.find_first_not_of('/');
+        if (start == std::string_view::npos) {
+            return id;
+        }
+    }
+
+    while (start < reference.size()) {
+        size_t end = reference.find('/', start);
+        if (end == std::string_view::npos) {
+            end = reference.size();
+        }
+        if (end > start) {
+            id = child(id, reference.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    // A trailing separator is kept as an empty last component, as fs::path does
+    if (reference.size() > 1 && reference.back() == '/' && id != base) {
+        id = child(id, "");
+    }
+    return id;
+}
+
+std::string_view PathTable::internName(std::string_view name) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = names_.find(name);
+        if (it != names_.end()) {
+            return *it;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    return internNameLocked(name);
+}
+
+std::string_view PathTable::internNameLocked(std::string_view name) {
+    auto it = names_.find(name);
+    if (it != names_.end()) {
+        return *it;
+    }
+    return *names_.insert(nameStorage_.emplace_back(name)).first;
+}
+
+PathTable::Id PathTable::normalized(Id id) const {
+    return nodes_[id].normalized;
+}
+
+PathTable::Id PathTable::parent(Id id) const {
+    return nodes_[id].parent;
+}
+
+std::string_view PathTable::name(Id id) const {
+    return nodes_[id].name;
+}
+
+std::string PathTable::toString(Id id) const {
+    std::string out;
+    appendTo(id, out);
+    return out;
+}
+
+fs::path PathTable::toPath(Id id) const {
+    return fs::path(toString(id));
+}
+
+std::string PathTable::relative(Id from, Id to) const {
+    Id a = from;
+    Id b = to;
+    std::vector<Id> descent;  // nodes from the common ancestor down to `to`
+    while (nodes_[a].depth > nodes_[b].depth) {
+        a = nodes_[a].parent;
+    }
+    while (nodes_[b].depth > nodes_[a].depth) {
+        descent.push_back(b);
+        b = nodes_[b].parent;
+    }
+    while (a != b) {
+        a = nodes_[a].parent;
+        descent.push_back(b);
+        b = nodes_[b].parent;
+    }
+
+    if (a == kEmpty && isRooted(from) != isRooted(to)) {
+        std::string out;
+        appendTo(to, out);
+        return out;
+    }
+
+    std::string out;
+    for (uint32_t up = nodes_[from].depth - nodes_[a].depth; up > 0; --up) {
+        out += out.empty() ? ".." : "/..";
+    }
+    for (auto it = descent.rbegin(); it != descent.rend(); ++it) {
+        if (!out.empty()) {
+            out += '/';
+        }
+        out += nodes_[*it].name;
+    }
+    return out.empty() ? "." : out;
+}
+
+std::string PathTable::respell(std::string_view reference, Id actual) const {
+    std::string out(reference);
+    Id current = actual;
+    if (current != kEmpty && nodes_[current].name.empty()) {
+        current = nodes_[current].parent;  // trailing separator
+    }
+
+    // Right to left, so the offsets of earlier components stay valid
+    size_t end = reference.size();
+    while (end > 0 && current != kEmpty) {
+        size_t separator = reference.rfind('/', end - 1);
+        size_t start = separator == std::string_view::npos ? 0 : separator + 1;
+        if (start < end) {
+            out.replace(start, end - start, nodes_[current].name);
+            current = nodes_[current].parent;
+        }
+        if (start == 0) {
+            break;
+        }
+        end = start - 1;
+    }
+    return out;
+}
+
+size_t PathTable::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return size_;
+}
+
+void PathTable::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    children_.clear();
+    nodes_.clear();
+    names_.clear();
+    nameStorage_.clear();
+    nodes_.at(kEmpty) = Node{kEmpty, 0, internNameLocked(""), kEmpty};
+    size_ = 1;
+}
+
+bool PathTable::isRooted(Id id) const {
+    if (id == kEmpty) {
+        return false;
+    }
+    while (nodes_[id].parent != kEmpty) {
+        id = nodes_[id].parent;
+    }
+    return nodes_[id].name == kRootName;
+}
+
+void PathTable::appendTo(Id id, std::string& out) const {
+    if (id == kEmpty) {
+        return;
+    }
+    const Node& node = nodes_[id];
+    appendTo(node.parent, out);
+    if (!out.empty() && out.back() != '/') {
+        out += '/';
+    }
+    out += node.name;
+}
@@ -0,0 +1,111 @@
+// path_table.h
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "SlotArray.h"
+
+namespace fs = std::filesystem;
+
+// Interned path storage. Every path is a node holding its parent's ID and an
+// interned name, so each distinct filename is stored once however many
+// directories contain it, and a path costs one small integer to pass around.
+// Paths are interned lexically, as written: "." and ".." are ordinary
+// components. Safe to share between threads; nodes are never removed except
+// by clear(). Creating a node takes a lock, but reading one never does: a
+// node is complete before its ID is handed out and never moves after.
+class PathTable {
+public:
+    using Id = uint32_t;
+
+    static constexpr Id kEmpty = 0;        // the empty relative path
+    static constexpr Id kNone = UINT32_MAX;
+
+    PathTable();
+
+    PathTable(const PathTable&) = delete;
+    PathTable& operator=(const PathTable&) = delete;
+
+    // Node for `name` inside `parent`, created on first use
+    Id child(Id parent, std::string_view name);
+
+    // Node for `path`, one component at a time
+    Id intern(const fs::path& path);
+
+    // Node for `reference` joined onto `base` the way fs::path::operator/
+    // joins them: a leading '/' starts again from the root
+    Id intern(Id base, std::string_view reference);
+
+    // Stable interned copy of `name`
+    std::string_view internName(std::string_view name);
+
+    // Lexically normalized form of `id`: no ".", empty or cancellable ".."
+    // components. Computed once, when the node is created.
+    Id normalized(Id id) const;
+
+    Id parent(Id id) const;
+    std::string_view name(Id id) const;
+
+    std::string toString(Id id) const;
+    fs::path toPath(Id id) const;
+
+    // Lexical path from directory `from` to `to`, walking up to their
+    // closest common ancestor. Paths under different roots have no such
+    // walk, so `to` is returned as it stands.
+    std::string relative(Id from, Id to) const;
+
+    // `reference` as written, with each component replaced by the name of
+    // the matching node on the way up from `actual`. Separators, "." and
+    // ".." are kept, so only the spelling of the names can change.
+    std::string respell(std::string_view reference, Id actual) const;
+
+    // Number of nodes, including the empty path
+    size_t size() const;
+
+    void clear();
+
+private:
+    struct Node {
+        Id parent;
+        uint32_t depth;
+        std::string_view name;
+        Id normalized;
+    };
+
+    struct ChildKey {
+        Id parent;
+        std::string_view name;
+        bool operator==(const ChildKey& other) const {
+            return parent == other.parent && name == other.name;
+        }
+    };
+
+    struct ChildKeyHash {
+        size_t operator()(const ChildKey& key) const {
+            return std::hash<std::string_view>()(key.name) * 31 + key.parent;
+        }
+    };
+
+    Id childLocked(Id parent, std::string_view name);
+    std::string_view internNameLocked(std::string_view name);
+    bool isRooted(Id id) const;
+    void appendTo(Id id, std::string& out) const;
+
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> nameStorage_;        // never moves what it holds
+    std::unordered_set<std::string_view> names_;  // views of nameStorage_, searchable without a copy
+    SlotArray<Node> nodes_;
+    Id size_ = 0;
+    std::unordered_map<ChildKey, Id, ChildKeyHash> children_;
+};
+
+#endif // PATH_TABLE_H
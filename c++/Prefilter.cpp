@@ -0,0 +1,185 @@
+#include "Prefilter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ReferenceRules.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#define PREFILTER_X86 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define PREFILTER_NEON 1
+#endif
+
+namespace {
+
+// First '=' in [p, end), or end. Attribute assignments are far rarer than
+// ordinary bytes, so the search runs a block at a time.
+const char* findEqualsScalar(const char* p, const char* end) {
+    const void* hit = std::memchr(p, '=', static_cast<size_t>(end - p));
+    return hit ? static_cast<const char*>(hit) : end;
+}
+
+#ifdef PREFILTER_X86
+const char* findEqualsSse2(const char* p, const char* end) {
+    const __m128i needle = _mm_set1_epi8('=');
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+    return findEqualsScalar(p, end);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+const char* findEqualsAvx2(const char* p, const char* end) {
+    const __m256i needle = _mm256_set1_epi8('=');
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findEqualsSse2(p, end);
+}
+#endif
+#endif // PREFILTER_X86
+
+#ifdef PREFILTER_NEON
+const char* findEqualsNeon(const char* p, const char* end) {
+    const uint8x16_t needle = vdupq_n_u8('=');
+    while (end - p >= 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(p)), needle);
+        // Narrow each byte lane to a nibble so the hit mask fits in 64 bits
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask != 0) {
+            return p + (__builtin_ctzll(mask) >> 2);
+        }
+        p += 16;
+    }
+    return findEqualsScalar(p, end);
+}
+#endif
+
+using FindEquals = const char* (*)(const char*, const char*);
+
+FindEquals selectFindEquals() {
+#ifdef PREFILTER_X86
+#if defined(__GNUC__) || defined(__clang__)
+    if (__builtin_cpu_supports("avx2")) {
+        return findEqualsAvx2;
+    }
+#endif
+    return findEqualsSse2;
+#elif defined(PREFILTER_NEON)
+    return findEqualsNeon;
+#else
+    return findEqualsScalar;
+#endif
+}
+
+const FindEquals findEquals = selectFindEquals();
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Kind of reference held by the attribute whose name ends just before
+// `nameEnd`, going by the name's ending; None for any other attribute
+ReferenceKind candidateKind(const char* begin, const char* nameEnd) {
+    auto endsWith = [&](std::string_view suffix) {
+        if (static_cast<size_t>(nameEnd - begin) < suffix.size()) {
+            return false;
+        }
+        const char* start = nameEnd - suffix.size();
+        for (size_t i = 0; i < suffix.size(); ++i) {
+            if (lower(start[i]) != suffix[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (const ReferenceRule& rule : kReferenceRules) {
+        if (rule.kind != ReferenceKind::Css && endsWith(rule.attribute)) {
+            return rule.kind;
+        }
+    }
+    return ReferenceKind::None;
+}
+
+// Could any style sheet or style attribute here hold a reference? Style
+// values aren't checked one by one: a url( or @import anywhere is enough,
+// in any case, as CSS reads them.
+bool mayContainCssReference(const char* begin, const char* end) {
+    for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '(', end - p))); ++p) {
+        if (p - begin >= 3 && lower(p[-3]) == 'u' && lower(p[-2]) == 'r' && lower(p[-1]) == 'l') {
+            return true;
+        }
+    }
+    constexpr std::string_view kImport = "import";
+    for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '@', end - p))); ++p) {
+        if (static_cast<size_t>(end - p - 1) >= kImport.size() &&
+            std::equal(kImport.begin(), kImport.end(), p + 1, [](char a, char b) { return a == lower(b); })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Is the attribute value at `p` empty? It may still be quoted, and runs on
+// to the end of the document.
+bool isEmptyValue(const char* p, const char* end) {
+    return p >= end || ((*p == '"' || *p == '\'') && p + 1 < end && p[1] == *p);
+}
+
+// Attribute values that can never name a file next to the page
+bool isNonLocalValue(const char* p, const char* end) {
+    if (isEmptyValue(p, end)) {
+        return true;
+    }
+    if (*p == '"' || *p == '\'') {
+        ++p;
+    }
+    return isNonLocalUrl(std::string_view(p, end - p));
+}
+
+} // namespace
+
+// prefilter.cpp
+bool mayContainLocalReference(std::string_view html) {
+    const char* begin = html.data();
+    const char* end = begin + html.size();
+
+    for (const char* eq = findEquals(begin, end); eq != end; eq = findEquals(eq + 1, end)) {
+        const char* nameEnd = eq;
+        while (nameEnd > begin && isSpace(nameEnd[-1])) {
+            --nameEnd;
+        }
+        const ReferenceKind kind = candidateKind(begin, nameEnd);
+        if (kind == ReferenceKind::None) {
+            continue;
+        }
+
+        const char* value = eq + 1;
+        while (value < end && isSpace(*value)) {
+            ++value;
+        }
+        // Any srcset candidate may be local, not just the first one
+        if (kind == ReferenceKind::SrcSet ? !isEmptyValue(value, end) : !isNonLocalValue(value, end)) {
+            return true;
+        }
+    }
+    return mayContainCssReference(begin, end);
+}
@@ -0,0 +1,14 @@
+// prefilter.h
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <string_view>
+
+// Cheap vectorized check run before any parsing. Returns false only when the
+// document certainly has no reference attribute (see kReferenceRules) whose
+// value could be a local path, and no CSS url( or @import at all; pages
+// without references, or with nothing but absolute URLs, fragments and the
+// like, never reach the parser. False positives are fine.
+bool mayContainLocalReference(std::string_view html);
+
+#endif // PREFILTER_H
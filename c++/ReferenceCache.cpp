@@ -0,0 +1,68 @@
+#include "ReferenceCache.h"
+
+// reference_cache.cpp
+ReferenceCache::ReferenceCache(size_t capacityBytes)
+    : shardCapacity_(capacityBytes / kShards) {
+}
+
+bool ReferenceCache::find(Id directory, std::string_view reference, Outcome& outcome) {
+    const Key key{directory, reference};
+    Shard& shard = shardFor(key);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    outcome = it->second->outcome;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ReferenceCache::insert(Id directory, std::string_view reference, const Outcome& outcome) {
+    const size_t bytes = kEntryOverhead + reference.size() + outcome.replacement.size();
+    Shard& shard = shardFor(Key{directory, reference});
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.count(Key{directory, reference}) != 0) {
+        return;  // another worker resolved the same reference meanwhile
+    }
+
+    shard.entries.push_front(Node{directory, std::string(reference), outcome, bytes});
+    const Node& node = shard.entries.front();
+    shard.index.emplace(Key{node.directory, node.reference}, shard.entries.begin());
+    shard.bytes += bytes;
+
+    while (shard.bytes > shardCapacity_ && shard.entries.size() > 1) {
+        const Node& victim = shard.entries.back();
+        shard.bytes -= victim.bytes;
+        shard.index.erase(Key{victim.directory, victim.reference});
+        shard.entries.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ReferenceCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+        shard.bytes = 0;
+    }
+}
+
+size_t ReferenceCache::size() const {
+    size_t total = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+ReferenceCache::Shard& ReferenceCache::shardFor(const Key& key) {
+    // The low bits pick the bucket inside the shard, so use the high ones
+    return shards_[(KeyHash()(key) >> 27) % kShards];
+}
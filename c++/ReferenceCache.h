@@ -0,0 +1,96 @@
+// reference_cache.h
+#ifndef REFERENCE_CACHE_H
+#define REFERENCE_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "PathTable.h"
+
+// Memo of resolved references, keyed by (page directory, reference as
+// written). Pages built from one template repeat the same references, and a
+// hit skips interning, resolution and respelling altogether. References that
+// don't resolve are cached too, as negative entries.
+//
+// Memory is bounded by a byte budget split across independently locked
+// shards; each shard evicts its least recently used entries past its share.
+class ReferenceCache {
+public:
+    using Id = PathTable::Id;
+
+    struct Outcome {
+        Id target = PathTable::kNone;  // the reference, interned under the directory
+        bool resolved = false;         // false: nothing on disk matches
+        std::string replacement;       // corrected spelling; empty if already right
+    };
+
+    static constexpr size_t kDefaultCapacityBytes = 64 << 20;
+
+    explicit ReferenceCache(size_t capacityBytes = kDefaultCapacityBytes);
+
+    ReferenceCache(const ReferenceCache&) = delete;
+    ReferenceCache& operator=(const ReferenceCache&) = delete;
+
+    // Copy the cached outcome into `outcome`; false on a miss
+    bool find(Id directory, std::string_view reference, Outcome& outcome);
+
+    void insert(Id directory, std::string_view reference, const Outcome& outcome);
+
+    // Drop every entry; needed whenever the PathTable IDs are reset
+    void clear();
+
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    size_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
+    size_t size() const;
+
+private:
+    static constexpr size_t kShards = 32;
+
+    // Rough bookkeeping cost of an entry beyond its strings
+    static constexpr size_t kEntryOverhead = 96;
+
+    struct Node {
+        Id directory;
+        std::string reference;
+        Outcome outcome;
+        size_t bytes;
+    };
+
+    // Views into a Node's own reference, so lookups never copy the key
+    struct Key {
+        Id directory;
+        std::string_view reference;
+        bool operator==(const Key& other) const {
+            return directory == other.directory && reference == other.reference;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<std::string_view>()(key.reference) ^ (size_t(key.directory) * 0x9E3779B97F4A7C15ull);
+        }
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Node> entries;  // most recently used first
+        std::unordered_map<Key, std::list<Node>::iterator, KeyHash> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shardFor(const Key& key);
+
+    size_t shardCapacity_;
+    mutable std::array<Shard, kShards> shards_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+    std::atomic<size_t> evictions_{0};
+};
+
+#endif // REFERENCE_CACHE_H
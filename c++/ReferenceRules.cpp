@@ -0,0 +1,132 @@
+#include "ReferenceRules.h"
+
+#include "CssUrlScanner.h"
+
+namespace {
+
+using namespace reference_rules_detail;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool equalsLowercase(std::string_view name, std::string_view lowercase) {
+    if (name.size() != lowercase.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (lower(name[i]) != lowercase[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void forEachSrcSetUrl(std::string_view value, const std::function<void(size_t, size_t)>& onUrl) {
+    size_t pos = 0;
+    const size_t size = value.size();
+    while (pos < size) {
+        while (pos < size && (isSpace(value[pos]) || value[pos] == ',')) {
+            ++pos;
+        }
+        if (pos >= size) {
+            break;
+        }
+
+        size_t start = pos;
+        while (pos < size && !isSpace(value[pos])) {
+            ++pos;
+        }
+        size_t end = pos;
+        bool endsCandidate = false;
+        while (end > start && value[end - 1] == ',') {
+            --end;
+            endsCandidate = true;
+        }
+        if (end > start) {
+            onUrl(start, end - start);
+        }
+
+        // Skip the descriptors ("2x", "100w") up to the next candidate
+        if (!endsCandidate) {
+            int depth = 0;
+            while (pos < size && (value[pos] != ',' || depth > 0)) {
+                depth += value[pos] == '(' ? 1 : value[pos] == ')' ? -1 : 0;
+                ++pos;
+            }
+        }
+    }
+}
+
+} // namespace
+
+// reference_rules.cpp
+int referenceAttribute(std::string_view attribute) {
+    size_t slot = hashName(attribute) & (kBucketCount - 1);
+    while (kBuckets[slot].count != 0) {
+        const size_t first = kBuckets[slot].first;
+        if (equalsLowercase(attribute, kReferenceRules[first].attribute)) {
+            return static_cast<int>(first);
+        }
+        slot = (slot + 1) & (kBucketCount - 1);
+    }
+    return -1;
+}
+
+ReferenceKind referenceKind(GumboTag tag, int attributeId) {
+    if (attributeId < 0) {
+        return ReferenceKind::None;
+    }
+    const std::string_view attribute = kReferenceRules[attributeId].attribute;
+    for (size_t i = static_cast<size_t>(attributeId); i < kRuleCount && kReferenceRules[i].attribute == attribute; ++i) {
+        if (kReferenceRules[i].tag == tag || kReferenceRules[i].tag == GUMBO_TAG_LAST) {
+            return kReferenceRules[i].kind;
+        }
+    }
+    return ReferenceKind::None;
+}
+
+void forEachUrl(ReferenceKind kind, std::string_view value,
+                const std::function<void(size_t offset, size_t length)>& onUrl) {
+    switch (kind) {
+    case ReferenceKind::None:
+        return;
+    case ReferenceKind::Url: {
+        size_t start = 0;
+        size_t end = value.size();
+        while (start < end && isSpace(value[start])) {
+            ++start;
+        }
+        while (end > start && isSpace(value[end - 1])) {
+            --end;
+        }
+        if (end > start) {
+            onUrl(start, end - start);
+        }
+        return;
+    }
+    case ReferenceKind::SrcSet:
+        forEachSrcSetUrl(value, onUrl);
+        return;
+    case ReferenceKind::Css:
+        scanCssUrls(value, onUrl);
+        return;
+    }
+}
+
+bool isNonLocalUrl(std::string_view url) {
+    if (url.empty() || url[0] == '#') {
+        return true;
+    }
+    if (url.size() >= 2 && url[0] == '/' && url[1] == '/') {
+        return true;
+    }
+
+    // A single-letter scheme is more likely a drive letter; keep it
+    size_t length = 0;
+    while (length < url.size() && ((lower(url[length]) >= 'a' && lower(url[length]) <= 'z') ||
+                                   url[length] == '+' || url[length] == '-' || url[length] == '.')) {
+        ++length;
+    }
+    return length < url.size() && url[length] == ':' && length >= 2;
+}
@@ -0,0 +1,122 @@
+// reference_rules.h
+#ifndef REFERENCE_RULES_H
+#define REFERENCE_RULES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "gumbo.h" // HTML parser library
+
+// How an attribute value holds its URLs
+enum class ReferenceKind : uint8_t {
+    None,
+    Url,     // the whole value is one URL
+    SrcSet,  // comma-separated "url [descriptor]" candidates
+    Css      // style declarations; URLs sit in url(...)
+};
+
+struct ReferenceRule {
+    GumboTag tag;                // GUMBO_TAG_LAST matches every element
+    std::string_view attribute;  // lowercase
+    ReferenceKind kind;
+};
+
+// Every attribute that can name a local file. Rules for one attribute must
+// be adjacent, with tag-specific rules before a catch-all.
+inline constexpr ReferenceRule kReferenceRules[] = {
+    {GUMBO_TAG_LAST, "src", ReferenceKind::Url},
+    {GUMBO_TAG_LAST, "href", ReferenceKind::Url},
+    {GUMBO_TAG_IMG, "srcset", ReferenceKind::SrcSet},
+    {GUMBO_TAG_SOURCE, "srcset", ReferenceKind::SrcSet},
+    {GUMBO_TAG_VIDEO, "poster", ReferenceKind::Url},
+    {GUMBO_TAG_OBJECT, "data", ReferenceKind::Url},
+    {GUMBO_TAG_LAST, "background", ReferenceKind::Url},
+    {GUMBO_TAG_FORM, "action", ReferenceKind::Url},
+    {GUMBO_TAG_LAST, "style", ReferenceKind::Css},
+};
+
+namespace reference_rules_detail {
+
+constexpr char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a over the lowercased name, usable at compile time
+constexpr uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(lower(c))) * 16777619u;
+    }
+    return hash;
+}
+
+constexpr size_t kRuleCount = sizeof(kReferenceRules) / sizeof(kReferenceRules[0]);
+constexpr size_t kBucketCount = 32;  // power of two, well above the attribute count
+
+// A run of adjacent rules for one attribute; count 0 marks an empty bucket
+struct Bucket {
+    uint8_t first;
+    uint8_t count;
+};
+
+constexpr bool rulesAreGrouped() {
+    for (size_t i = 0; i < kRuleCount; ++i) {
+        for (size_t j = i + 2; j < kRuleCount; ++j) {
+            if (kReferenceRules[i].attribute == kReferenceRules[j].attribute &&
+                kReferenceRules[j - 1].attribute != kReferenceRules[j].attribute) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+constexpr std::array<Bucket, kBucketCount> buildBuckets() {
+    std::array<Bucket, kBucketCount> buckets{};
+    size_t slot = 0;
+    for (size_t i = 0; i < kRuleCount; ++i) {
+        if (i > 0 && kReferenceRules[i].attribute == kReferenceRules[i - 1].attribute) {
+            ++buckets[slot].count;
+            continue;
+        }
+        slot = hashName(kReferenceRules[i].attribute) & (kBucketCount - 1);
+        while (buckets[slot].count != 0) {
+            slot = (slot + 1) & (kBucketCount - 1);
+        }
+        buckets[slot] = Bucket{static_cast<uint8_t>(i), 1};
+    }
+    return buckets;
+}
+
+inline constexpr std::array<Bucket, kBucketCount> kBuckets = buildBuckets();
+
+static_assert(rulesAreGrouped(), "rules for one attribute must be adjacent");
+static_assert(kRuleCount < kBucketCount / 2, "grow kBucketCount with the rule table");
+
+} // namespace reference_rules_detail
+
+// Identifies the attribute of a rule group: the group's first rule index, or
+// -1 for attributes no rule mentions. One hash probe and a single name
+// comparison to confirm the hit; `attribute` may be in any case.
+int referenceAttribute(std::string_view attribute);
+
+// Kind of reference attribute `attributeId` carries on a `tag` element
+ReferenceKind referenceKind(GumboTag tag, int attributeId);
+
+inline ReferenceKind referenceKind(GumboTag tag, std::string_view attribute) {
+    return referenceKind(tag, referenceAttribute(attribute));
+}
+
+// Call onUrl(offset, length) for each URL in `value`, offsets relative to it
+void forEachUrl(ReferenceKind kind, std::string_view value,
+                const std::function<void(size_t offset, size_t length)>& onUrl);
+
+// Can `url` never name a file next to the page? True when it is empty or a
+// fragment, protocol-relative, or scheme-qualified (http:, mailto:, data:,
+// ...); only the start of `url` is looked at.
+bool isNonLocalUrl(std::string_view url);
+
+#endif // REFERENCE_RULES_H
@@ -0,0 +1,102 @@
+#include "ReverseIndex.h"
+
+#include <algorithm>
+
+#include "CaseFolding.h"
+
+// reverse_index.cpp
+void ReverseIndex::record(const fs::path& page, const std::vector<std::string>& directories) {
+    const std::string key = page.string();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    eraseLocked(key);
+    for (const auto& directory : directories) {
+        dependents_[directory].insert(key);
+    }
+    directories_[key] = directories;
+}
+
+void ReverseIndex::erase(const fs::path& page) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    eraseLocked(page.string());
+}
+
+std::vector<fs::path> ReverseIndex::dependents(const fs::path& directory) const {
+    std::vector<fs::path> pages;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = dependents_.find(directory.string());
+    if (it != dependents_.end()) {
+        pages.assign(it->second.begin(), it->second.end());
+    }
+    return pages;
+}
+
+std::vector<fs::path> ReverseIndex::affectedBy(const fs::path& path) const {
+    const std::string target = comparable(path);
+    const std::string parent = comparable(fs::path(target).parent_path());
+
+    std::unordered_set<std::string> pages;
+    std::unordered_set<std::string> parentPages;
+    bool listed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [directory, dependents] : dependents_) {
+            const std::string key = comparable(directory);
+            if (key.compare(0, target.size(), target) == 0 &&
+                (key.size() == target.size() || key[target.size()] == '/')) {
+                pages.insert(dependents.begin(), dependents.end());
+                listed = listed || key.size() == target.size();
+            } else if (key == parent) {
+                parentPages = dependents;
+            }
+        }
+    }
+    if (!listed) {
+        pages.insert(parentPages.begin(), parentPages.end());
+    }
+
+    std::vector<fs::path> sorted(pages.begin(), pages.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+size_t ReverseIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directories_.size();
+}
+
+void ReverseIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directories_.clear();
+    dependents_.clear();
+}
+
+std::string ReverseIndex::comparable(const fs::path& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec).lexically_normal();
+    if (ec) {
+        absolute = path.lexically_normal();
+    }
+    if (!absolute.has_filename() && absolute.has_parent_path() && absolute != absolute.root_path()) {
+        absolute = absolute.parent_path();
+    }
+    return foldCase(absolute.string());
+}
+
+void ReverseIndex::eraseLocked(const std::string& page) {
+    auto previous = directories_.find(page);
+    if (previous == directories_.end()) {
+        return;
+    }
+    for (const auto& directory : previous->second) {
+        auto it = dependents_.find(directory);
+        if (it == dependents_.end()) {
+            continue;
+        }
+        it->second.erase(page);
+        if (it->second.empty()) {
+            dependents_.erase(it);
+        }
+    }
+    directories_.erase(previous);
+}
@@ -0,0 +1,57 @@
+// reverse_index.h
+#ifndef REVERSE_INDEX_H
+#define REVERSE_INDEX_H
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Which pages depend on which directory listings: the inverse of the
+// dependencies the manifest keeps per page. When a listing changes, the
+// pages recorded against it are the ones whose corrections may differ.
+// Directories are keyed as DirectoryIndex::listingPath() spells them.
+// Nothing is stored of its own: the manifest already persists every page's
+// dependencies, and loading it back is a matter of inverting them.
+// Thread-safe.
+class ReverseIndex {
+public:
+    // Replace whatever `page` was recorded as depending on
+    void record(const fs::path& page, const std::vector<std::string>& directories);
+
+    // Forget `page`, e.g. because it was deleted
+    void erase(const fs::path& page);
+
+    // Pages recorded against `directory`
+    std::vector<fs::path> dependents(const fs::path& directory) const;
+
+    // Pages a change to `path` may affect: those recorded against it or any
+    // listing below it. When `path` isn't a recorded listing itself (a file,
+    // or a directory no page looked into), the pages recorded against its
+    // parent's listing, where it was added, removed or renamed, count too.
+    // Paths are compared absolute and ignoring case, so either spelling of a
+    // renamed directory finds the same pages, and the disk isn't consulted.
+    // Sorted.
+    std::vector<fs::path> affectedBy(const fs::path& path) const;
+
+    // Pages recorded
+    size_t size() const;
+
+    void clear();
+
+private:
+    void eraseLocked(const std::string& page);
+
+    // Absolute, lexically normal and case-folded, with no trailing separator
+    static std::string comparable(const fs::path& path);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<std::string>> directories_;       // page -> listings
+    std::unordered_map<std::string, std::unordered_set<std::string>> dependents_;  // listing -> pages
+};
+
+#endif // REVERSE_INDEX_H
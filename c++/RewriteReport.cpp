@@ -0,0 +1,101 @@
+#include "RewriteReport.h"
+
+#include <iostream>
+#include <stdexcept>
+
+// rewrite_report.cpp
+RewriteReport::RewriteReport(const fs::path& path)
+    : out_(&std::cout) {
+    if (path != "-") {
+        file_.open(path, std::ios::binary | std::ios::trunc);
+        if (!file_) {
+            throw std::runtime_error("Cannot write report: " + path.string());
+        }
+        out_ = &file_;
+    }
+}
+
+void RewriteReport::record(const fs::path& htmlFile, std::string_view content,
+                           const std::vector<TextEdit>& edits, uint64_t base) {
+    if (edits.empty()) {
+        return;
+    }
+
+    std::string file;
+    appendJsonString(file, htmlFile.string());
+
+    std::string lines;
+    for (const auto& edit : edits) {
+        lines += "{\"file\":";
+        lines += file;
+        lines += ",\"offset\":";
+        lines += std::to_string(base + edit.offset);
+        lines += ",\"old\":";
+        appendJsonString(lines, content.substr(edit.offset, edit.length));
+        lines += ",\"new\":";
+        appendJsonString(lines, edit.replacement);
+        lines += "}\n";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_->write(lines.data(), static_cast<std::streamsize>(lines.size()));
+    entries_ += edits.size();
+}
+
+void RewriteReport::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!out_->flush()) {
+        throw std::runtime_error("Cannot write report");
+    }
+}
+
+size_t RewriteReport::entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_;
+}
+
+void RewriteReport::merge(const std::vector<fs::path>& inputs, const fs::path& output) {
+    RewriteReport merged(output);
+    for (const auto& input : inputs) {
+        std::ifstream file(input, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Cannot read report: " + input.string());
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            *merged.out_ << line << '\n';
+            ++merged.entries_;
+        }
+        if (file.bad()) {
+            throw std::runtime_error("Cannot read report: " + input.string());
+        }
+    }
+    merged.flush();
+}
+
+void RewriteReport::appendJsonString(std::string& out, std::string_view value) {
+    static const char kHex[] = "0123456789abcdef";
+
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += kHex[(c >> 4) & 0xf];
+                out += kHex[c & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
@@ -0,0 +1,51 @@
+// rewrite_report.h
+#ifndef REWRITE_REPORT_H
+#define REWRITE_REPORT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SpliceRewriter.h"
+
+namespace fs = std::filesystem;
+
+// Streaming JSON Lines log of rewrites, one object per edit:
+//   {"file":"a/index.html","offset":120,"old":"IMG/x.PNG","new":"img/x.png"}
+// Lines are formatted by the calling thread and appended under a lock, so
+// the report never holds more than one document's entries in memory.
+class RewriteReport {
+public:
+    // Write to `path`, or to stdout when `path` is "-"
+    explicit RewriteReport(const fs::path& path);
+
+    // Append one line per edit; `edits` must be normalized against `content`,
+    // which starts `base` bytes into the page (a window of a streamed page)
+    void record(const fs::path& htmlFile, std::string_view content, const std::vector<TextEdit>& edits,
+                uint64_t base = 0);
+
+    // Flush buffered lines (throws std::runtime_error on write failure)
+    void flush();
+
+    size_t entries() const;
+
+    static void appendJsonString(std::string& out, std::string_view value);
+
+    // Concatenate the reports of several shards into `output` ("-" for
+    // stdout), in the order given. Shards never share a page, so nothing
+    // needs reconciling. Throws std::runtime_error.
+    static void merge(const std::vector<fs::path>& inputs, const fs::path& output);
+
+private:
+    std::ofstream file_;
+    std::ostream* out_;
+    mutable std::mutex mutex_;
+    size_t entries_ = 0;
+};
+
+#endif // REWRITE_REPORT_H
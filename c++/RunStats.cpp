@@ -0,0 +1,294 @@
+#include "RunStats.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "AtomicWriter.h"
+
+namespace {
+std::atomic<uint64_t> nextId{1};
+
+// Slot of the instance this thread last recorded into
+struct CachedSlot {
+    uint64_t owner = 0;
+    void* slot = nullptr;
+};
+thread_local CachedSlot cached;
+
+void bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    // Single writer: a plain load and store, no locked instruction
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+double seconds(uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e9;
+}
+
+std::string fixed(double value, int precision) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(precision) << value;
+    return out.str();
+}
+
+// Exported seconds are written from the integer total, so that load() gets
+// back every nanosecond; through a double, totals past 2^53 would not survive
+std::string exactSeconds(uint64_t nanoseconds) {
+    std::ostringstream out;
+    out << nanoseconds / 1000000000 << '.' << std::setw(9) << std::setfill('0') << nanoseconds % 1000000000;
+    return out.str();
+}
+
+uint64_t parseCount(const char* begin, const char* end) {
+    uint64_t value = 0;
+    std::from_chars(begin, end, value);
+    return value;
+}
+
+// Inverse of exactSeconds; fewer decimals are fine, more are cut off
+uint64_t parseNanoseconds(const char* begin, const char* end) {
+    uint64_t whole = 0;
+    const char* p = std::from_chars(begin, end, whole).ptr;
+    uint64_t fraction = 0;
+    if (p < end && *p == '.') {
+        ++p;
+        for (uint64_t scale = 100000000; scale > 0 && p < end && *p >= '0' && *p <= '9'; ++p, scale /= 10) {
+            fraction += static_cast<uint64_t>(*p - '0') * scale;
+        }
+    }
+    return whole * 1000000000 + fraction;
+}
+}
+
+// run_stats.cpp
+RunStats::Totals& RunStats::Totals::operator+=(const Totals& other) {
+    for (size_t i = 0; i < kCounters; ++i) {
+        counts[i] += other.counts[i];
+    }
+    for (size_t i = 0; i < kTimers; ++i) {
+        nanoseconds[i] += other.nanoseconds[i];
+        calls[i] += other.calls[i];
+    }
+    wallNanoseconds = std::max(wallNanoseconds, other.wallNanoseconds);
+    return *this;
+}
+
+RunStats::ScopedTimer::ScopedTimer(RunStats* stats, Timer timer)
+    : stats_(stats), timer_(timer) {
+    if (stats_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+RunStats::ScopedTimer::~ScopedTimer() {
+    if (stats_) {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        stats_->addTime(timer_, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+}
+
+RunStats::RunStats()
+    : id_(nextId.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+void RunStats::add(Counter counter, uint64_t amount) {
+    bump(slot().counts[static_cast<size_t>(counter)], amount);
+}
+
+void RunStats::addTime(Timer timer, uint64_t nanoseconds) {
+    Slot& own = slot();
+    bump(own.nanoseconds[static_cast<size_t>(timer)], nanoseconds);
+    bump(own.calls[static_cast<size_t>(timer)], 1);
+}
+
+void RunStats::setWallTime(uint64_t nanoseconds) {
+    wallNanoseconds_.store(nanoseconds, std::memory_order_relaxed);
+}
+
+void RunStats::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Slot& slot : slots_) {
+        for (auto& value : slot.counts) {
+            value.store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < kTimers; ++i) {
+            slot.nanoseconds[i].store(0, std::memory_order_relaxed);
+            slot.calls[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    wallNanoseconds_.store(0, std::memory_order_relaxed);
+}
+
+RunStats::Totals RunStats::totals() const {
+    Totals totals;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Slot& slot : slots_) {
+        for (size_t i = 0; i < kCounters; ++i) {
+            totals.counts[i] += slot.counts[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < kTimers; ++i) {
+            totals.nanoseconds[i] += slot.nanoseconds[i].load(std::memory_order_relaxed);
+            totals.calls[i] += slot.calls[i].load(std::memory_order_relaxed);
+        }
+    }
+    totals.wallNanoseconds = wallNanoseconds_.load(std::memory_order_relaxed);
+    return totals;
+}
+
+RunStats::Slot& RunStats::slot() {
+    if (cached.owner == id_) {
+        return *static_cast<Slot*>(cached.slot);
+    }
+
+    // A thread that exited leaves its slot to whichever thread reuses its id
+    std::lock_guard<std::mutex> lock(mutex_);
+    Slot*& own = owners_[std::this_thread::get_id()];
+    if (!own) {
+        own = &slots_.emplace_back();
+    }
+    cached = CachedSlot{id_, own};
+    return *own;
+}
+
+const char* RunStats::name(Counter counter) {
+    switch (counter) {
+    case Counter::FilesScanned: return "files_scanned";
+    case Counter::FilesSkipped: return "files_skipped";
+    case Counter::FilesUnchanged: return "files_unchanged";
+    case Counter::FilesRewritten: return "files_rewritten";
+    case Counter::ReferencesResolved: return "references_resolved";
+    case Counter::ReferencesUnresolved: return "references_unresolved";
+    case Counter::ReferencesCorrected: return "references_corrected";
+    case Counter::CacheHits: return "cache_hits";
+    case Counter::BytesRead: return "bytes_read";
+    case Counter::BytesWritten: return "bytes_written";
+    case Counter::Count: break;
+    }
+    return "unknown";
+}
+
+const char* RunStats::name(Timer timer) {
+    switch (timer) {
+    case Timer::Read: return "read";
+    case Timer::Parse: return "parse";
+    case Timer::Resolve: return "resolve";
+    case Timer::Splice: return "splice";
+    case Timer::Write: return "write";
+    case Timer::Count: break;
+    }
+    return "unknown";
+}
+
+std::string RunStats::summary(const Totals& totals) {
+    std::ostringstream out;
+    for (size_t i = 0; i < kCounters; ++i) {
+        out << std::left << std::setw(24) << name(static_cast<Counter>(i))
+            << std::right << std::setw(14) << totals.counts[i] << '\n';
+    }
+
+    // Stages run on every worker at once, so their sum may exceed the wall time
+    out << '\n' << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "calls"
+        << std::setw(12) << "seconds" << std::setw(12) << "us/call" << '\n';
+    for (size_t i = 0; i < kTimers; ++i) {
+        const double perCall = totals.calls[i] ? static_cast<double>(totals.nanoseconds[i]) / 1e3 /
+                                                 static_cast<double>(totals.calls[i]) : 0.0;
+        out << std::left << std::setw(10) << name(static_cast<Timer>(i)) << std::right
+            << std::setw(12) << totals.calls[i] << std::setw(12) << fixed(seconds(totals.nanoseconds[i]), 3)
+            << std::setw(12) << fixed(perCall, 2) << '\n';
+    }
+    out << std::left << std::setw(10) << "wall" << std::right << std::setw(24)
+        << fixed(seconds(totals.wallNanoseconds), 3) << '\n';
+    return out.str();
+}
+
+std::string RunStats::json(const Totals& totals) {
+    std::ostringstream out;
+    out << "{\"wall_seconds\":" << exactSeconds(totals.wallNanoseconds) << ",\"counters\":{";
+    for (size_t i = 0; i < kCounters; ++i) {
+        out << (i ? "," : "") << '"' << name(static_cast<Counter>(i)) << "\":" << totals.counts[i];
+    }
+    out << "},\"timers\":{";
+    for (size_t i = 0; i < kTimers; ++i) {
+        out << (i ? "," : "") << '"' << name(static_cast<Timer>(i)) << "\":{\"calls\":" << totals.calls[i]
+            << ",\"seconds\":" << exactSeconds(totals.nanoseconds[i]) << '}';
+    }
+    out << "}}\n";
+    return out.str();
+}
+
+std::string RunStats::prometheus(const Totals& totals) {
+    constexpr const char* kPrefix = "html_case_corrector_";
+    std::ostringstream out;
+    for (size_t i = 0; i < kCounters; ++i) {
+        const char* counter = name(static_cast<Counter>(i));
+        out << "# TYPE " << kPrefix << counter << "_total counter\n"
+            << kPrefix << counter << "_total " << totals.counts[i] << '\n';
+    }
+
+    out << "# TYPE " << kPrefix << "stage_seconds_total counter\n";
+    for (size_t i = 0; i < kTimers; ++i) {
+        out << kPrefix << "stage_seconds_total{stage=\"" << name(static_cast<Timer>(i)) << "\"} "
+            << exactSeconds(totals.nanoseconds[i]) << '\n';
+    }
+    out << "# TYPE " << kPrefix << "stage_calls_total counter\n";
+    for (size_t i = 0; i < kTimers; ++i) {
+        out << kPrefix << "stage_calls_total{stage=\"" << name(static_cast<Timer>(i)) << "\"} "
+            << totals.calls[i] << '\n';
+    }
+    out << "# TYPE " << kPrefix << "run_seconds gauge\n"
+        << kPrefix << "run_seconds " << exactSeconds(totals.wallNanoseconds) << '\n';
+    return out.str();
+}
+
+RunStats::Totals RunStats::load(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.good() && !file.eof()) {
+        throw std::runtime_error("Cannot read stats: " + path.string());
+    }
+    if (text.find("\"counters\"") == std::string::npos) {
+        throw std::runtime_error("Not a stats export: " + path.string());
+    }
+
+    // The export is flat enough that every value follows its quoted name;
+    // the start of the value, or null if the name isn't there
+    const char* end = text.data() + text.size();
+    auto value = [&text](size_t from, std::string_view key) -> const char* {
+        const std::string quoted = "\"" + std::string(key) + "\":";
+        size_t at = text.find(quoted, from);
+        return at != std::string::npos ? text.data() + at + quoted.size() : nullptr;
+    };
+
+    Totals totals;
+    if (const char* wall = value(0, "wall_seconds")) {
+        totals.wallNanoseconds = parseNanoseconds(wall, end);
+    }
+    const size_t timers = text.find("\"timers\"");
+    for (size_t i = 0; i < kCounters; ++i) {
+        if (const char* count = value(0, name(static_cast<Counter>(i)))) {
+            totals.counts[i] = parseCount(count, end);
+        }
+    }
+    for (size_t i = 0; timers != std::string::npos && i < kTimers; ++i) {
+        const size_t stage = text.find("\"" + std::string(name(static_cast<Timer>(i))) + "\":{", timers);
+        if (stage == std::string::npos) {
+            continue;
+        }
+        if (const char* calls = value(stage, "calls")) {
+            totals.calls[i] = parseCount(calls, end);
+        }
+        if (const char* elapsed = value(stage, "seconds")) {
+            totals.nanoseconds[i] = parseNanoseconds(elapsed, end);
+        }
+    }
+    return totals;
+}
+
+void RunStats::save(const Totals& totals, const fs::path& path) {
+    AtomicWriter writer;
+    writer.write(path, path.extension() == ".prom" ? prometheus(totals) : json(totals));
+}
@@ -0,0 +1,137 @@
+// run_stats.h
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// Counters and stage timers for one run. Every thread accumulates into a
+// slot of its own, so the hot path is an add to a thread-private counter
+// with no shared cache line and no atomic read-modify-write; totals() merges
+// the slots. Meant to be read between runs or from a monitoring thread,
+// whose view may then lag by a few updates.
+class RunStats {
+public:
+    enum class Counter {
+        FilesScanned,          // pages whose content was examined
+        FilesSkipped,          // ruled out by the prefilter before parsing
+        FilesUnchanged,        // settled by the manifest without reading
+        FilesRewritten,
+        ReferencesResolved,    // references that name an existing file
+        ReferencesUnresolved,
+        ReferencesCorrected,   // resolved references spelled in the wrong case
+        CacheHits,             // references answered by the reference cache
+        BytesRead,
+        BytesWritten,
+        Count
+    };
+
+    enum class Timer {
+        Read,     // mapping or reading pages
+        Parse,    // gumbo_parse, or the lexer
+        Resolve,  // directory lookups, including listings read on demand
+        Splice,   // applying edits (what replaceInContent used to be)
+        Write,    // atomic replaces
+        Count
+    };
+
+    static constexpr size_t kCounters = static_cast<size_t>(Counter::Count);
+    static constexpr size_t kTimers = static_cast<size_t>(Timer::Count);
+
+    struct Totals {
+        std::array<uint64_t, kCounters> counts{};
+        std::array<uint64_t, kTimers> nanoseconds{};
+        std::array<uint64_t, kTimers> calls{};
+        uint64_t wallNanoseconds = 0;
+
+        uint64_t count(Counter counter) const { return counts[static_cast<size_t>(counter)]; }
+
+        // Fold in the totals of a run that went alongside this one (another
+        // shard): counts and stage times add up, the wall time is the longest
+        Totals& operator+=(const Totals& other);
+    };
+
+    // Times a scope into `timer`; does nothing when `stats` is null
+    class ScopedTimer {
+    public:
+        ScopedTimer(RunStats* stats, Timer timer);
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        RunStats* stats_;
+        Timer timer_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    RunStats();
+
+    RunStats(const RunStats&) = delete;
+    RunStats& operator=(const RunStats&) = delete;
+
+    void add(Counter counter, uint64_t amount = 1);
+    void addTime(Timer timer, uint64_t nanoseconds);
+
+    // Wall time of the whole run, next to the per-stage sums
+    void setWallTime(uint64_t nanoseconds);
+
+    // Zero everything; only while no other thread is recording
+    void reset();
+
+    Totals totals() const;
+
+    // snake_case names used by every format
+    static const char* name(Counter counter);
+    static const char* name(Timer timer);
+
+    // Aligned table for a terminal
+    static std::string summary(const Totals& totals);
+
+    static std::string json(const Totals& totals);
+
+    // Prometheus text exposition format, for a node_exporter textfile collector
+    static std::string prometheus(const Totals& totals);
+
+    // Write `totals` to `path`: Prometheus for a .prom file, JSON otherwise.
+    // Replaces the file atomically; throws std::runtime_error.
+    static void save(const Totals& totals, const fs::path& path);
+
+    // Read back a JSON export (throws std::runtime_error). Names it doesn't
+    // know are ignored, so exports from other versions still merge.
+    static Totals load(const fs::path& path);
+
+private:
+    // Owned by one thread, which is the only writer; loads and stores are
+    // relaxed so that totals() may read while it runs. Cache-line aligned,
+    // so two threads' slots never share a line.
+    struct alignas(64) Slot {
+        std::array<std::atomic<uint64_t>, kCounters> counts{};
+        std::array<std::atomic<uint64_t>, kTimers> nanoseconds{};
+        std::array<std::atomic<uint64_t>, kTimers> calls{};
+    };
+
+    // The calling thread's slot, created on its first update
+    Slot& slot();
+
+    const uint64_t id_;  // tells instances apart in the per-thread cache
+    std::atomic<uint64_t> wallNanoseconds_{0};
+
+    mutable std::mutex mutex_;
+    std::deque<Slot> slots_;  // stable addresses
+    std::unordered_map<std::thread::id, Slot*> owners_;
+};
+
+#endif // RUN_STATS_H
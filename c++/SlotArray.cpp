@@ -0,0 +1,18 @@
+#include "SlotArray.h"
+
+// slot_array.cpp
+size_t slotArraySegment(uint32_t id, size_t& offset, size_t& segmentSize) {
+    // Shifted by the first segment's size, an ID's top bit names its segment
+    const uint64_t shifted = uint64_t(id) + (uint64_t(1) << kSlotArrayFirstBits);
+#if defined(__GNUC__)
+    const unsigned top = 63 - static_cast<unsigned>(__builtin_clzll(shifted));
+#else
+    unsigned top = 0;
+    while ((shifted >> (top + 1)) != 0) {
+        ++top;
+    }
+#endif
+    segmentSize = size_t(1) << top;
+    offset = static_cast<size_t>(shifted - segmentSize);
+    return top - kSlotArrayFirstBits;
+}
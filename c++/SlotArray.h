@@ -0,0 +1,90 @@
+// slot_array.h
+#ifndef SLOT_ARRAY_H
+#define SLOT_ARRAY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Where slot `id` lives: segment s holds 1 << (kSlotArrayFirstBits + s)
+// slots, so a few dozen segments cover every 32-bit ID and none is ever
+// reallocated
+constexpr unsigned kSlotArrayFirstBits = 10;
+constexpr size_t kSlotArraySegments = 33 - kSlotArrayFirstBits;
+size_t slotArraySegment(uint32_t id, size_t& offset, size_t& segmentSize);
+
+// Array indexed by dense IDs (PathTable's) that grows a segment at a time
+// without moving what it holds. A slot's address is fixed from its first
+// use, so one thread can read a slot while another allocates further out;
+// what the slots hold decides how their contents are shared.
+template <typename T>
+class SlotArray {
+public:
+    SlotArray() = default;
+    ~SlotArray() { clear(); }
+
+    SlotArray(const SlotArray&) = delete;
+    SlotArray& operator=(const SlotArray&) = delete;
+
+    // Slot `id`, allocating its segment if needed. Safe to call from any
+    // number of threads: racing allocations keep the first segment published.
+    T& at(uint32_t id) {
+        size_t offset;
+        size_t size;
+        std::atomic<T*>& segment = segments_[slotArraySegment(id, offset, size)];
+        T* slots = segment.load(std::memory_order_acquire);
+        if (!slots) {
+            T* fresh = new T[size]();
+            if (segment.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel)) {
+                slots = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return slots[offset];
+    }
+
+    // Slot `id`, whose segment at() has already allocated
+    T& operator[](uint32_t id) const {
+        size_t offset;
+        size_t size;
+        return segments_[slotArraySegment(id, offset, size)].load(std::memory_order_acquire)[offset];
+    }
+
+    // Slot `id` if its segment was ever allocated, or null; never allocates
+    T* find(uint32_t id) const {
+        size_t offset;
+        size_t size;
+        T* slots = segments_[slotArraySegment(id, offset, size)].load(std::memory_order_acquire);
+        return slots ? slots + offset : nullptr;
+    }
+
+    // Call `visit(id, slot)` for every allocated slot; not while at() runs
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        for (size_t s = 0; s < kSlotArraySegments; ++s) {
+            T* slots = segments_[s].load(std::memory_order_acquire);
+            if (!slots) {
+                continue;
+            }
+            const size_t first = ((size_t(1) << s) - 1) << kSlotArrayFirstBits;
+            const size_t size = size_t(1) << (s + kSlotArrayFirstBits);
+            for (size_t i = 0; i < size; ++i) {
+                visit(static_cast<uint32_t>(first + i), slots[i]);
+            }
+        }
+    }
+
+    // Free every segment; nothing else may use the array meanwhile
+    void clear() {
+        for (auto& segment : segments_) {
+            delete[] segment.exchange(nullptr, std::memory_order_acq_rel);
+        }
+    }
+
+private:
+    std::array<std::atomic<T*>, kSlotArraySegments> segments_{};
+};
+
+#endif // SLOT_ARRAY_H
@@ -0,0 +1,40 @@
+#include "SpliceRewriter.h"
+
+#include <algorithm>
+
+// splice_rewriter.cpp
+size_t normalizeEdits(std::string_view content, std::vector<TextEdit>& edits) {
+    std::sort(edits.begin(), edits.end(), [](const TextEdit& a, const TextEdit& b) {
+        return a.offset < b.offset;
+    });
+
+    // Drop edits that fall outside the document or overlap their predecessor
+    size_t end = 0;
+    size_t resultSize = content.size();
+    auto kept = std::remove_if(edits.begin(), edits.end(), [&](const TextEdit& edit) {
+        if (edit.offset < end || edit.offset + edit.length > content.size()) {
+            return true;
+        }
+        end = edit.offset + edit.length;
+        resultSize = resultSize - edit.length + edit.replacement.size();
+        return false;
+    });
+    edits.erase(kept, edits.end());
+    return resultSize;
+}
+
+std::string applyEdits(std::string_view content, std::vector<TextEdit>& edits) {
+    const size_t resultSize = normalizeEdits(content, edits);
+
+    std::string result;
+    result.reserve(resultSize);
+
+    size_t pos = 0;
+    for (const auto& edit : edits) {
+        result.append(content.data() + pos, edit.offset - pos);
+        result.append(edit.replacement);
+        pos = edit.offset + edit.length;
+    }
+    result.append(content.data() + pos, content.size() - pos);
+    return result;
+}
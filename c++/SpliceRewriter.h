@@ -0,0 +1,24 @@
+// splice_rewriter.h
+#ifndef SPLICE_REWRITER_H
+#define SPLICE_REWRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Replace `length` bytes at `offset` of the original document
+struct TextEdit {
+    size_t offset;
+    size_t length;
+    std::string replacement;
+};
+
+// Sort edits by offset and drop any that fall outside `content` or overlap an
+// earlier edit. Returns the size of the document once they are applied.
+size_t normalizeEdits(std::string_view content, std::vector<TextEdit>& edits);
+
+// Build the rewritten document in one pass over `content`. Edits may be given
+// in any order; they are normalized in place first.
+std::string applyEdits(std::string_view content, std::vector<TextEdit>& edits);
+
+#endif // SPLICE_REWRITER_H
@@ -0,0 +1,104 @@
+#include "SyntheticTree.h"
+
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+constexpr const char* kFiller =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua. ";
+
+void writeFile(const fs::path& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !(file << content)) {
+        throw std::runtime_error("Cannot write file: " + path.string());
+    }
+}
+}
+
+// synthetic_tree.cpp
+SyntheticTree generateSyntheticTree(const fs::path& root, const SyntheticTreeOptions& options) {
+    fs::remove_all(root);
+
+    SyntheticTree tree;
+    tree.root = root;
+
+    // Breadth first, so directories come out level by level
+    std::vector<std::pair<fs::path, unsigned>> pending{{root, 0}};
+    for (size_t next = 0; next < pending.size(); ++next) {
+        const auto [directory, level] = pending[next];
+        fs::create_directories(directory);
+        tree.directories.push_back(directory);
+
+        for (unsigned i = 0; i < options.assetsPerDirectory; ++i) {
+            fs::path asset = directory / ("Asset" + std::to_string(i) + (i % 2 ? ".PNG" : ".Jpg"));
+            writeFile(asset, "");
+            tree.assets.push_back(std::move(asset));
+        }
+        for (unsigned i = 0; i < options.pagesPerDirectory; ++i) {
+            tree.pages.push_back(directory / ("Page" + std::to_string(i) + ".html"));
+        }
+        if (level < options.depth) {
+            for (unsigned i = 0; i < options.fanOut; ++i) {
+                pending.emplace_back(directory / ("Section" + std::to_string(i)), level + 1);
+            }
+        }
+    }
+
+    // Pages go last so that every asset they reference already exists
+    for (size_t i = 0; i < tree.pages.size(); ++i) {
+        std::string content = syntheticPage(tree.pages[i], tree.assets, options,
+                                            options.seed + static_cast<uint32_t>(i));
+        tree.pageBytes += content.size();
+        writeFile(tree.pages[i], content);
+    }
+    return tree;
+}
+
+std::string syntheticPage(const fs::path& page, const std::vector<fs::path>& assets,
+                          const SyntheticTreeOptions& options, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    const fs::path directory = page.parent_path();
+    const double bytesPerReference = options.referencesPerKiB > 0 ? 1024.0 / options.referencesPerKiB : 0;
+
+    std::string content = "<!DOCTYPE html>\n<html><head><title>" + page.filename().string() +
+                          "</title></head><body>\n";
+    double untilReference = bytesPerReference;
+    size_t references = 0;
+    while (content.size() < options.pageBytes) {
+        content += "<p>";
+        content += kFiller;
+        content += "</p>\n";
+        untilReference -= 7 + std::char_traits<char>::length(kFiller);
+
+        while (bytesPerReference > 0 && untilReference <= 0 && !assets.empty()) {
+            const fs::path& asset = assets[random() % assets.size()];
+            std::string url = asset.lexically_relative(directory).generic_string();
+            if (chance(random) < options.wrongCaseRatio) {
+                url = scrambleCase(url, static_cast<uint32_t>(random()));
+            }
+            content += references++ % 2 ? "<a href=\"" + url + "\">link</a>\n" : "<img src=\"" + url + "\">\n";
+            untilReference += bytesPerReference;
+        }
+    }
+    content += "</body></html>\n";
+    return content;
+}
+
+std::string scrambleCase(const std::string& path, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::string scrambled = path;
+    for (char& c : scrambled) {
+        if (random() % 2 == 0) {
+            continue;
+        }
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        } else if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return scrambled;
+}
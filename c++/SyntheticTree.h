@@ -0,0 +1,47 @@
+// synthetic_tree.h
+#ifndef SYNTHETIC_TREE_H
+#define SYNTHETIC_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Shape of a generated site. Every directory holds the same number of pages
+// and assets; pages reference assets anywhere in the tree with relative
+// URLs, some of them in the wrong case.
+struct SyntheticTreeOptions {
+    unsigned depth = 2;               // directory levels below the root
+    unsigned fanOut = 4;              // subdirectories per directory
+    unsigned pagesPerDirectory = 8;
+    unsigned assetsPerDirectory = 8;
+    size_t pageBytes = 8 * 1024;      // approximate size of each page
+    double referencesPerKiB = 2.0;    // reference density
+    double wrongCaseRatio = 0.5;      // share of references spelled in the wrong case
+    uint32_t seed = 1;                // same options and seed, same tree
+};
+
+struct SyntheticTree {
+    fs::path root;
+    std::vector<fs::path> directories;  // including the root
+    std::vector<fs::path> pages;
+    std::vector<fs::path> assets;
+    size_t pageBytes = 0;               // total size of the pages
+};
+
+// Create the tree under `root`, replacing whatever is there (throws
+// fs::filesystem_error)
+SyntheticTree generateSyntheticTree(const fs::path& root, const SyntheticTreeOptions& options);
+
+// Contents of one page stored at `page`, referencing `assets`; the
+// generator writes exactly this
+std::string syntheticPage(const fs::path& page, const std::vector<fs::path>& assets,
+                          const SyntheticTreeOptions& options, uint32_t seed);
+
+// `path` with the case of its letters scrambled
+std::string scrambleCase(const std::string& path, uint32_t seed);
+
+#endif // SYNTHETIC_TREE_H
@@ -0,0 +1,139 @@
+#include "WorkStealingPool.h"
+
+namespace {
+// Owning pool and index of the worker running on this thread, if any
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+}
+
+// work_stealing_pool.cpp
+WorkStealingPool::WorkStealingPool(unsigned threads, size_t capacity)
+    : capacity_(capacity) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        threads_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopping_ = true;
+    }
+    workAvailable_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    const bool fromWorker = currentPool == this;
+    unsigned target = fromWorker
+        ? currentWorker
+        : nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+    // Count the task before it becomes visible so a worker that pops it
+    // straight away never drives the counters below zero.
+    pending_.fetch_add(1);
+    if (capacity_ != 0 && !fromWorker) {
+        reserveSlot();
+    } else {
+        queued_.fetch_add(1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+        workers_[target]->tasks.push_back(std::move(task));
+    }
+    wakeParked(workAvailable_, idleWorkers_);
+}
+
+void WorkStealingPool::reserveSlot() {
+    size_t queued = queued_.load();
+    for (;;) {
+        if (queued < capacity_) {
+            if (queued_.compare_exchange_weak(queued, queued + 1)) {
+                return;
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        ++blockedProducers_;
+        spaceAvailable_.wait(lock, [this] { return queued_.load() < capacity_; });
+        --blockedProducers_;
+        queued = queued_.load();
+    }
+}
+
+void WorkStealingPool::wakeParked(std::condition_variable& condition, const std::atomic<unsigned>& parked) {
+    if (parked.load() == 0) {
+        return;
+    }
+    // Once the lock is free again, a thread that counted itself parked is
+    // really waiting, so the notification can't slip past it
+    { std::lock_guard<std::mutex> lock(stateMutex_); }
+    condition.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    allDone_.wait(lock, [this] { return pending_.load() == 0; });
+}
+
+void WorkStealingPool::workerLoop(unsigned self) {
+    currentPool = this;
+    currentWorker = self;
+
+    Task task;
+    for (;;) {
+        if (popTask(self, task)) {
+            queued_.fetch_sub(1);
+            wakeParked(spaceAvailable_, blockedProducers_);
+            task();
+            task = nullptr;
+
+            // Rare enough to notify unconditionally; wait() rechecks under the lock
+            if (pending_.fetch_sub(1) == 1) {
+                { std::lock_guard<std::mutex> lock(stateMutex_); }
+                allDone_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        ++idleWorkers_;
+        workAvailable_.wait(lock, [this] { return queued_.load() > 0 || stopping_; });
+        --idleWorkers_;
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::popTask(unsigned self, Task& task) {
+    {
+        Worker& own = *workers_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(self + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
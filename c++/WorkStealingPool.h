@@ -0,0 +1,73 @@
+// work_stealing_pool.h
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool. Each worker owns a task deque: it pops its own work
+// from the back and, once that runs dry, steals from the front of the others.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // `capacity` bounds how many queued tasks outside producers may have in
+    // flight before submit blocks; 0 means unbounded.
+    explicit WorkStealingPool(unsigned threads, size_t capacity = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Queue a task; tasks must not throw. Called from a worker, the task goes
+    // to that worker's own deque and never blocks; otherwise deques are
+    // filled round-robin and the caller waits while the pool is at capacity.
+    void submit(Task task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned self);
+    bool popTask(unsigned self, Task& task);
+
+    // Count a task into queued_, waiting while the pool is at capacity
+    void reserveSlot();
+
+    // Wake a thread parked on `condition`, if `parked` says there is one
+    void wakeParked(std::condition_variable& condition, const std::atomic<unsigned>& parked);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<unsigned> nextWorker_{0};
+
+    // The counters are atomics, so submitting and finishing a task takes no
+    // shared lock; stateMutex_ is only for parking threads and waking them.
+    // A thread counts itself parked under the lock before checking what it
+    // waits for, so a waker that sees no one parked can skip the lock.
+    std::mutex stateMutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable allDone_;
+    std::condition_variable spaceAvailable_;
+    size_t capacity_;
+    std::atomic<size_t> queued_{0};   // tasks sitting in a deque
+    std::atomic<size_t> pending_{0};  // tasks submitted but not yet finished
+    std::atomic<unsigned> idleWorkers_{0};
+    std::atomic<unsigned> blockedProducers_{0};
+    bool stopping_ = false;  // guarded by stateMutex_
+};
+
+#endif // WORK_STEALING_POOL_H
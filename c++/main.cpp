@@ -1,25 +1,260 @@
 #include "html_case_corrector.h"
+#include "RewriteReport.h"
+#include <charconv>
+#include <csignal>
 #include <iostream>
+#include <limits>
+#include <pthread.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+// More workers than this only ever comes from a typo
+constexpr long long kMaxJobs = 1024;
+constexpr long long kMaxShards = std::numeric_limits<unsigned>::max();
+
+// `text`, all of it, as a number in [min, max]
+bool parseNumber(std::string_view text, long long min, long long max, long long& value) {
+    const char* end = text.data() + text.size();
+    auto [stop, error] = std::from_chars(text.data(), end, value);
+    return error == std::errc() && stop == end && value >= min && value <= max;
+}
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <directory>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <directory> [--jobs N] [--engine gumbo|lexer]"
+                  << " [--manifest FILE] [--dry-run] [--report FILE|-]"
+                  << " [--sync none|batch|file] [--io sync|uring] [--watch]"
+                  << " [--affected-by PATH]... [--stats] [--stats-export FILE.json|FILE.prom]"
+                  << " [--shard I/N] [--index-snapshot FILE] [--stream-threshold BYTES]" << std::endl;
+        std::cerr << "       " << argv[0] << " --merge-reports OUT|- REPORT..." << std::endl;
+        std::cerr << "       " << argv[0] << " --merge-stats OUT|- STATS.json..." << std::endl;
+        std::cerr << "Pages are rewritten by atomic replacement; a hard-linked page is split from its"
+                  << " other links, which keep the old content." << std::endl;
         return 1;
     }
 
     try {
-        fs::path startDir = argv[1];
+        // Combining what the shards of a run left behind
+        const std::string mode = argv[1];
+        if (mode == "--merge-reports" || mode == "--merge-stats") {
+            if (argc < 4) {
+                std::cerr << "Error: " << mode << " requires an output and at least one input" << std::endl;
+                return 1;
+            }
+            const fs::path output = argv[2];
+            std::vector<fs::path> inputs(argv + 3, argv + argc);
+            if (mode == "--merge-reports") {
+                RewriteReport::merge(inputs, output);
+                return 0;
+            }
+            RunStats::Totals totals;
+            for (const auto& input : inputs) {
+                totals += RunStats::load(input);
+            }
+            if (output == "-") {
+                std::cout << RunStats::summary(totals);
+            } else {
+                RunStats::save(totals, output);
+            }
+            return 0;
+        }
+
+        fs::path startDir;
+        unsigned jobs = 1;
+        ParseEngine engine = ParseEngine::Gumbo;
+        fs::path manifest;
+        fs::path report;
+        bool dryRun = false;
+        bool watch = false;
+        std::vector<fs::path> affectedBy;
+        bool stats = false;
+        fs::path statsExport;
+        fs::path indexSnapshot;
+        uint64_t streamThreshold = HtmlCaseCorrector::kDefaultStreamingThreshold;
+        unsigned shardIndex = 0;
+        unsigned shardCount = 1;
+        SyncPolicy sync = SyncPolicy::None;
+        IoEngine io = IoEngine::Sync;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--jobs" || arg == "-j") {
+                long long count = 0;
+                if (i + 1 >= argc || !parseNumber(argv[++i], 1, kMaxJobs, count)) {
+                    std::cerr << "Error: " << arg << " requires a thread count (1-" << kMaxJobs << ")" << std::endl;
+                    return 1;
+                }
+                jobs = static_cast<unsigned>(count);
+            } else if (arg == "--engine") {
+                std::string name = i + 1 < argc ? argv[++i] : "";
+                if (name == "gumbo") {
+                    engine = ParseEngine::Gumbo;
+                } else if (name == "lexer") {
+                    engine = ParseEngine::Lexer;
+                } else {
+                    std::cerr << "Error: --engine must be 'gumbo' or 'lexer'" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--manifest") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --manifest requires a file name" << std::endl;
+                    return 1;
+                }
+                manifest = argv[++i];
+            } else if (arg == "--dry-run") {
+                dryRun = true;
+            } else if (arg == "--watch") {
+                watch = true;
+            } else if (arg == "--stats") {
+                stats = true;
+            } else if (arg == "--stats-export") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --stats-export requires a file name" << std::endl;
+                    return 1;
+                }
+                statsExport = argv[++i];
+            } else if (arg == "--index-snapshot") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --index-snapshot requires a file name" << std::endl;
+                    return 1;
+                }
+                indexSnapshot = argv[++i];
+            } else if (arg == "--stream-threshold") {
+                long long bytes = 0;
+                if (i + 1 >= argc ||
+                    !parseNumber(argv[++i], 0, std::numeric_limits<long long>::max(), bytes)) {
+                    std::cerr << "Error: --stream-threshold requires a size in bytes (0 never streams)" << std::endl;
+                    return 1;
+                }
+                streamThreshold = static_cast<uint64_t>(bytes);
+            } else if (arg == "--shard") {
+                const std::string_view spec = i + 1 < argc ? argv[++i] : "";
+                const size_t slash = spec.find('/');
+                long long index = 0;
+                long long count = 0;
+                if (slash == std::string_view::npos || !parseNumber(spec.substr(slash + 1), 1, kMaxShards, count) ||
+                    !parseNumber(spec.substr(0, slash), 0, count - 1, index)) {
+                    std::cerr << "Error: --shard must be I/N, e.g. 0/4" << std::endl;
+                    return 1;
+                }
+                shardIndex = static_cast<unsigned>(index);
+                shardCount = static_cast<unsigned>(count);
+            } else if (arg == "--affected-by") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --affected-by requires a path" << std::endl;
+                    return 1;
+                }
+                affectedBy.push_back(argv[++i]);
+            } else if (arg == "--report") {
+                if (i + 1 >= argc) {
+                    std::cerr << "Error: --report requires a file name or '-'" << std::endl;
+                    return 1;
+                }
+                report = argv[++i];
+            } else if (arg == "--sync") {
+                std::string name = i + 1 < argc ? argv[++i] : "";
+                if (name == "none") {
+                    sync = SyncPolicy::None;
+                } else if (name == "batch") {
+                    sync = SyncPolicy::Batch;
+                } else if (name == "file") {
+                    sync = SyncPolicy::File;
+                } else {
+                    std::cerr << "Error: --sync must be 'none', 'batch' or 'file'" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--io") {
+                std::string name = i + 1 < argc ? argv[++i] : "";
+                if (name == "sync") {
+                    io = IoEngine::Sync;
+                } else if (name == "uring") {
+                    io = IoEngine::Uring;
+                } else {
+                    std::cerr << "Error: --io must be 'sync' or 'uring'" << std::endl;
+                    return 1;
+                }
+            } else if (!arg.empty() && arg[0] == '-') {
+                // A mistyped flag must not pass for the directory, e.g. --dryrun
+                std::cerr << "Error: unknown option " << arg << std::endl;
+                return 1;
+            } else if (!startDir.empty()) {
+                std::cerr << "Error: more than one directory given: " << startDir << " and " << fs::path(arg) << std::endl;
+                return 1;
+            } else {
+                startDir = arg;
+            }
+        }
+
         if (!fs::exists(startDir) || !fs::is_directory(startDir)) {
             std::cerr << "Error: " << startDir << " is not a valid directory" << std::endl;
             return 1;
         }
 
         HtmlCaseCorrector corrector;
-        corrector.processDirectory(startDir);
+        corrector.setJobs(jobs);
+        corrector.setEngine(engine);
+        corrector.setManifest(manifest);
+        corrector.setDryRun(dryRun);
+        corrector.setSyncPolicy(sync);
+        corrector.setIoEngine(io);
+        corrector.setShard(shardIndex, shardCount);
+        corrector.setIndexSnapshot(indexSnapshot);
+        corrector.setStreamingThreshold(streamThreshold);
+        corrector.setStats(stats || !statsExport.empty());
+        // A dry run is only useful if the plan goes somewhere
+        corrector.setReport(dryRun && report.empty() ? fs::path("-") : report);
+        // Printed once the run is done; a watch reports when it ends, with
+        // the wall time of its first pass
+        auto reportStats = [&] {
+            if (!corrector.stats()) {
+                return;
+            }
+            const RunStats::Totals totals = corrector.stats()->totals();
+            if (stats) {
+                std::cerr << RunStats::summary(totals);
+            }
+            if (!statsExport.empty()) {
+                RunStats::save(totals, statsExport);
+            }
+        };
+
+        if (!affectedBy.empty()) {
+            if (manifest.empty()) {
+                std::cerr << "Error: --affected-by needs the --manifest of an earlier run" << std::endl;
+                return 1;
+            }
+            corrector.processAffected(startDir, affectedBy);
+            reportStats();
+            return 0;
+        }
+        if (!watch) {
+            corrector.processDirectory(startDir);
+            reportStats();
+            return 0;
+        }
+
+        // Ctrl-C and SIGTERM end the watch after its current batch, so the
+        // manifest is saved. Blocked before any worker thread exists, so only
+        // the waiting thread ever receives them.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        std::thread([&corrector, signals] {
+            int signal = 0;
+            sigwait(&signals, &signal);
+            corrector.stopWatching();
+        }).detach();
+
+        corrector.watch(startDir);
+        reportStats();
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
 }
-